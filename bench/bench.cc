@@ -77,8 +77,91 @@ void async_bench() {
     bench("async_logger", 3, 5'000'000, 100);
 }
 
+void mmap_bench() {
+    // 与async_bench相同的条件，落地方向换成内存映射文件
+    std::unique_ptr<wlog::LoggerBuilder> builder =
+        std::make_unique<wlog::GlobalLoggerBuilder>();
+    builder->buildName("mmap_logger");
+    builder->buildFommatter("%m%n");
+    builder->buildType(wlog::LoggerType::ASYNC);
+    builder->enableUnsafeAsync();
+    builder->buildSink<wlog::MmapSink>("./logs/mmap-");
+    builder->build();
+    bench("mmap_logger", 3, 5'000'000, 100);
+}
+
+void ring_bench() {
+    // 每线程环形缓冲区，观察吞吐是否随生产者数量增长
+    std::unique_ptr<wlog::LoggerBuilder> builder =
+        std::make_unique<wlog::GlobalLoggerBuilder>();
+    builder->buildName("ring_logger");
+    builder->buildFommatter("%m%n");
+    builder->buildType(wlog::LoggerType::ASYNC);
+    builder->enableUnsafeAsync();
+    builder->enableRingLooper();
+    builder->buildSink<wlog::FileSink>("./logs/ring.log");
+    builder->build();
+    for (size_t threads : {1, 2, 4, 8}) {
+        bench("ring_logger", threads, 2'000'000, 100);
+    }
+}
+
+void deferred_bench() {
+    // 生产者只写入参数，格式化在工作线程中完成
+    std::unique_ptr<wlog::LoggerBuilder> builder =
+        std::make_unique<wlog::GlobalLoggerBuilder>();
+    builder->buildName("deferred_logger");
+    builder->buildType(wlog::LoggerType::ASYNC);
+    builder->enableUnsafeAsync();
+    builder->enableDeferredFormat();
+    builder->buildSink<wlog::FileSink>("./logs/deferred.log");
+    builder->build();
+    bench("deferred_logger", 3, 5'000'000, 100);
+}
+
+void parallel_bench() {
+    // 同一个日志器由多个线程并行格式化，观察吞吐是否随格式化线程数增长
+    for (size_t format_threads : {1, 2, 4}) {
+        std::string name = "parallel_logger" + std::to_string(format_threads);
+        std::unique_ptr<wlog::LoggerBuilder> builder =
+            std::make_unique<wlog::GlobalLoggerBuilder>();
+        builder->buildName(name);
+        builder->buildType(wlog::LoggerType::ASYNC);
+        builder->enableUnsafeAsync();
+        builder->enableParallelFormat(format_threads);
+        builder->buildSink<wlog::FileSink>("./logs/" + name + ".log");
+        builder->build();
+        bench(name, 3, 3'000'000, 100);
+    }
+}
+
+void shared_bench() {
+    // 多个日志器共用后台线程池，不再每个日志器各占一个线程
+    wlog::LoggerManager::getInstance().setBackendThreads(2);
+    for (int i = 0; i < 4; i++) {
+        std::string name = "shared_logger" + std::to_string(i);
+        std::unique_ptr<wlog::LoggerBuilder> builder =
+            std::make_unique<wlog::GlobalLoggerBuilder>();
+        builder->buildName(name);
+        builder->buildFommatter("%m%n");
+        builder->buildType(wlog::LoggerType::ASYNC);
+        builder->enableUnsafeAsync();
+        builder->enableSharedBackend();
+        builder->buildSink<wlog::FileSink>("./logs/" + name + ".log");
+        builder->build();
+    }
+    for (int i = 0; i < 4; i++) {
+        bench("shared_logger" + std::to_string(i), 3, 1'000'000, 100);
+    }
+}
+
 int main() {
     // sync_bench();
     async_bench();
+    mmap_bench();
+    ring_bench();
+    deferred_bench();
+    parallel_bench();
+    shared_bench();
     return 0;
 }
@@ -0,0 +1,52 @@
+// 被禁用的日志调用开销：
+//   1. logger->debug(...)：参数先求值，进入函数后才检查等级
+//   2. WLOG_INFO(...)：运行期被等级过滤，先检查等级，参数不求值
+//   3. WLOG_DEBUG(...)：编译期被WLOG_ACTIVE_LEVEL移除
+#define WLOG_ACTIVE_LEVEL WLOG_LEVEL_INFO
+
+#include <chrono>
+#include <string>
+
+#include "../logs/wlog.h"
+
+static volatile size_t g_evaluated = 0;
+
+// 模拟有代价的参数
+std::string expensive(size_t i) {
+    g_evaluated = g_evaluated + 1;
+    return std::to_string(i);
+}
+
+template <typename Fn>
+void run(const char* name, size_t count, Fn&& fn) {
+    g_evaluated = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < count; i++) fn(i);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::nano> cost = end - start;
+    std::cout << "\t" << name << ": " << cost.count() / count
+              << "ns/次, 参数求值 " << g_evaluated << " 次" << std::endl;
+}
+
+int main() {
+    std::unique_ptr<wlog::LoggerBuilder> builder =
+        std::make_unique<wlog::GlobalLoggerBuilder>();
+    builder->buildName("disabled_logger");
+    builder->buildType(wlog::LoggerType::SYNC);
+    builder->buildLimitLevel(wlog::LogLevel::Value::WARNING);
+    builder->build();
+    wlog::Logger::ptr logger = wlog::getLogger("disabled_logger");
+
+    const size_t count = 50'000'000;
+    std::cout << "被禁用的日志调用，次数: " << count << std::endl;
+    run("logger->debug(...)", count, [&](size_t i) {
+        logger->debug("%zu %s", i, expensive(i).c_str());
+    });
+    run("WLOG_INFO(运行期过滤)", count, [&](size_t i) {
+        WLOG_INFO(logger, "%zu %s", i, expensive(i).c_str());
+    });
+    run("WLOG_DEBUG(编译期移除)", count, [&](size_t /*i*/) {
+        WLOG_DEBUG(logger, "%zu %s", i, expensive(i).c_str());
+    });
+    return 0;
+}
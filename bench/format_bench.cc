@@ -0,0 +1,98 @@
+// 格式化器性能对比：运行期解析的Formatter vs 编译期展开的StaticFormatter，
+// 结构化字段的二进制编码 vs printf拼接字段，
+// 以及数值较多的消息上花括号格式(std::to_chars) vs vsnprintf
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "../logs/brace_format.hpp"
+#include "../logs/format.hpp"
+
+// 与默认格式结构相同但不相等，保证Formatter走运行期解析的子项
+inline constexpr char kPattern[] =
+    "[%d{%Y-%m-%d %H:%M:%S}][%t][%c][%p][%f:%l]%T%m%n";
+
+template <typename Fn>
+double run(const char* name, size_t count, Fn&& fn) {
+    auto start = std::chrono::high_resolution_clock::now();
+    size_t bytes = 0;
+    for (size_t i = 0; i < count; i++) bytes += fn();
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::nano> cost = end - start;
+    double ns = cost.count() / count;
+    std::cout << "\t" << name << ": " << ns << "ns/条, 输出 " << bytes / 1024
+              << "KB" << std::endl;
+    return ns;
+}
+
+int main() {
+    const size_t count = 2'000'000;
+    std::string payload(80, 'a');
+    wlog::LogMsg msg(wlog::LogLevel::Value::INFO, "bench_logger", __FILE__,
+                     __LINE__, payload);
+    std::cout << "格式: " << kPattern << "，条数: " << count << std::endl;
+
+    // 1. 运行期解析，逐个子项虚函数调用写入stringstream
+    wlog::Formatter::ptr runtime = std::make_shared<wlog::Formatter>(kPattern);
+    double dyn = run("Formatter(stringstream)", count, [&]() {
+        std::stringstream ss;
+        runtime->format(ss, msg);
+        return ss.str().size();
+    });
+
+    // 2. 编译期展开，直接追加到std::string
+    std::string out;
+    double sta = run("StaticFormatter(string)", count, [&]() {
+        out.clear();
+        wlog::StaticFormatter<kPattern>::format(out, msg);
+        return out.size();
+    });
+
+    std::cout << "\t加速比: " << dyn / sta << std::endl;
+
+    // 3. 生产者侧的字段处理：printf文本转换 vs 二进制编码
+    std::cout << "字段: uid/cost/ratio/path" << std::endl;
+    const char* path = "/api/v1/login";
+    char text[256];
+    double fmt = run("vsnprintf", count, [&]() {
+        return (size_t)snprintf(text, sizeof(text),
+                                "uid=%d cost=%lldus ratio=%f path=%s", 42,
+                                (long long)1500, 0.25, path);
+    });
+    std::string encoded;
+    double enc = run("FieldCodec::encode", count, [&]() {
+        wlog::Field fields[] = {
+            wlog::kv("uid", 42), wlog::kv("cost", std::chrono::microseconds(1500)),
+            wlog::kv("ratio", 0.25), wlog::kv("path", path)};
+        encoded.clear();
+        wlog::FieldCodec::encode(encoded, fields, 4);
+        return encoded.size();
+    });
+    std::cout << "\t加速比: " << fmt / enc << std::endl;
+
+    // 4. 数值较多的有效消息：vsnprintf vs 花括号格式
+    std::cout << "消息: 6个整数 + 2个浮点数" << std::endl;
+    long long id = 1234567, bytes_in = 987654321, bytes_out = 123456789;
+    int status = 200, retries = 3, shard = 17;
+    double latency = 1532.25, ratio = 0.9375;
+    double printf_ns = run("vsnprintf", count, [&]() {
+        return (size_t)snprintf(
+            text, sizeof(text),
+            "id=%lld in=%lld out=%lld status=%d retries=%d shard=%d "
+            "latency=%gus ratio=%g",
+            id, bytes_in, bytes_out, status, retries, shard, latency, ratio);
+    });
+    std::string braced;
+    double brace_ns = run("BraceFormat", count, [&]() {
+        braced.clear();
+        wlog::BraceFormat::format(
+            braced,
+            "id={} in={} out={} status={} retries={} shard={} "
+            "latency={}us ratio={}",
+            id, bytes_in, bytes_out, status, retries, shard, latency, ratio);
+        return braced.size();
+    });
+    std::cout << "\t加速比: " << printf_ns / brace_ns << std::endl;
+    return 0;
+}
@@ -0,0 +1,445 @@
+// 延迟分布测试：统计每次日志调用的耗时分布(p50/p99/p99.9/max)
+//   可以对线程数、消息长度、格式、落地方向、工作器类型做组合测试，
+//   结果以JSON或CSV输出，便于跟踪性能回退
+//   --slow-sink-us 给每次落地注入延迟，模拟磁盘卡顿时生产者的尾延迟
+//   --buffers 异步工作器的缓冲区总数，配合--slow-sink-us观察空闲缓冲区对尾延迟的影响
+//   落地方向：null / file / roll / stdout / fd / fd-interval / fd-batch / mmap /
+//   compress，fd-*为文件描述符落地方向的不同持久化策略；
+//   加queued-前缀(例如queued-file)时放在独立的落地队列中，队列满时丢弃最早的批次
+//
+// 用法：
+//   ./latency_bench --threads=1,2,4 --sizes=64,512 --patterns=simple,default
+//                   --sinks=null,file --loopers=safe,unsafe --count=200000
+//                   --slow-sink-us=0 --buffers=4 --output=json --out=result.json
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../logs/wlog.h"
+
+// 对数分桶的延迟直方图，每个2的幂区间再分16个子桶，相对误差约6%
+class Histogram {
+public:
+    Histogram() : _buckets(kBucketCount, 0), _count(0), _max(0), _sum(0) {}
+
+    void record(uint64_t ns) {
+        _buckets[index(ns)]++;
+        _count++;
+        _sum += ns;
+        _max = std::max(_max, ns);
+    }
+
+    void merge(const Histogram& other) {
+        for (size_t i = 0; i < kBucketCount; i++)
+            _buckets[i] += other._buckets[i];
+        _count += other._count;
+        _sum += other._sum;
+        _max = std::max(_max, other._max);
+    }
+
+    // 返回分位数对应桶的上界
+    uint64_t percentile(double p) const {
+        if (_count == 0) return 0;
+        uint64_t target = (uint64_t)std::ceil(_count * p);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBucketCount; i++) {
+            seen += _buckets[i];
+            if (seen >= target) return std::min(upper(i), _max);
+        }
+        return _max;
+    }
+
+    uint64_t count() const { return _count; }
+    uint64_t max() const { return _max; }
+    double mean() const { return _count ? (double)_sum / _count : 0; }
+
+private:
+    static constexpr int kSubBits = 4;
+    static constexpr size_t kBucketCount = 64 << kSubBits;
+
+    static size_t index(uint64_t v) {
+        if (v < (1u << kSubBits)) return v;
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - kSubBits;
+        size_t sub = (v >> shift) & ((1u << kSubBits) - 1);
+        return ((size_t)(shift + 1) << kSubBits) + sub;
+    }
+    static uint64_t upper(size_t i) {
+        if (i < (1u << kSubBits)) return i;
+        int shift = (int)(i >> kSubBits) - 1;
+        uint64_t sub = i & ((1u << kSubBits) - 1);
+        return (((1ull << kSubBits) + sub + 1) << shift) - 1;
+    }
+
+    std::vector<uint64_t> _buckets;
+    uint64_t _count;
+    uint64_t _max;
+    uint64_t _sum;
+};
+
+// 丢弃数据的落地方向，排除磁盘的影响
+class NullSink : public wlog::LogSink {
+public:
+    void log(const char* /*data*/, size_t /*len*/) override {}
+};
+
+// 每次落地前注入固定延迟，模拟卡顿的磁盘或管道
+class SlowSink : public wlog::LogSink {
+public:
+    SlowSink(const wlog::LogSink::ptr& sink, size_t delay_us)
+        : _sink(sink), _delay_us(delay_us) {}
+    void log(const char* data, size_t len) override {
+        if (_delay_us > 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(_delay_us));
+        _sink->log(data, len);
+    }
+
+private:
+    wlog::LogSink::ptr _sink;
+    size_t _delay_us;
+};
+
+struct Options {
+    std::vector<size_t> threads = {1, 2, 4};
+    std::vector<size_t> sizes = {64, 512};
+    std::vector<std::string> patterns = {"simple", "default"};
+    std::vector<std::string> sinks = {"null", "file"};
+    std::vector<std::string> loopers = {"safe", "unsafe"};
+    size_t count = 200'000;  // 每个组合的总消息数
+    size_t slow_sink_us = 0;
+    size_t buffers = DEFAULT_BUFFER_COUNT;
+    std::string output = "json";
+    std::string out;
+    std::string dir = "./logs/latency";
+};
+
+struct Result {
+    size_t threads;
+    size_t size;
+    std::string pattern;
+    std::string sink;
+    std::string looper;
+    size_t slow_sink_us;
+    Histogram hist;
+    double seconds;
+    size_t peak_inflight;  // 待落地缓冲区数量的峰值
+};
+
+std::vector<std::string> split(const std::string& str) {
+    std::vector<std::string> res;
+    std::stringstream ss(str);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty()) res.push_back(item);
+    return res;
+}
+
+std::vector<size_t> splitNumbers(const std::string& str) {
+    std::vector<size_t> res;
+    for (auto& item : split(str)) res.push_back(std::stoul(item));
+    return res;
+}
+
+bool parseOptions(int argc, char* argv[], Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+            std::cerr << "无法识别的参数: " << arg << std::endl;
+            return false;
+        }
+        std::string key = arg.substr(2, eq - 2);
+        std::string val = arg.substr(eq + 1);
+        if (key == "threads")
+            opt.threads = splitNumbers(val);
+        else if (key == "sizes")
+            opt.sizes = splitNumbers(val);
+        else if (key == "patterns")
+            opt.patterns = split(val);
+        else if (key == "sinks")
+            opt.sinks = split(val);
+        else if (key == "loopers")
+            opt.loopers = split(val);
+        else if (key == "count")
+            opt.count = std::stoul(val);
+        else if (key == "slow-sink-us")
+            opt.slow_sink_us = std::stoul(val);
+        else if (key == "buffers")
+            opt.buffers = std::stoul(val);
+        else if (key == "output")
+            opt.output = val;
+        else if (key == "out")
+            opt.out = val;
+        else if (key == "dir")
+            opt.dir = val;
+        else {
+            std::cerr << "无法识别的参数: " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string patternOf(const std::string& name) {
+    if (name == "simple") return "%m%n";
+    if (name == "default") return wlog::DEFAULT_PATTERN;
+    if (name == "precise") return "[%d{%H:%M:%S.%us}][%t][%p][%f:%l]%T%m%n";
+    return name;  // 其他值直接作为格式字符串
+}
+
+wlog::LogSink::ptr createSink(const Options& opt, const std::string& name) {
+    if (name.compare(0, 7, "queued-") == 0) {
+        wlog::LogSink::ptr sink = createSink(opt, name.substr(7));
+        if (!sink) return nullptr;
+        return std::make_shared<wlog::QueuedSink>(
+            sink, wlog::SinkQueueConfig(wlog::LooperType::DROP_OLDEST));
+    }
+    wlog::LogSink::ptr sink;
+    if (name == "null")
+        sink = std::make_shared<NullSink>();
+    else if (name == "file")
+        sink = std::make_shared<wlog::FileSink>(opt.dir + "/file.log");
+    else if (name == "roll")
+        sink = std::make_shared<wlog::RollSinkBySize>(opt.dir + "/roll-",
+                                                      64 * 1024 * 1024);
+    else if (name == "stdout")
+        sink = std::make_shared<wlog::StdoutSink>();
+    else if (name == "fd")
+        sink = std::make_shared<wlog::FdSink>(opt.dir + "/fd.log");
+    else if (name == "fd-interval")
+        sink = std::make_shared<wlog::FdSink>(
+            opt.dir + "/fd-interval.log",
+            wlog::SyncPolicy::interval(4 * 1024 * 1024,
+                                       std::chrono::milliseconds(100)));
+    else if (name == "compress")
+        sink = std::make_shared<wlog::CompressSink>(opt.dir + "/compress.wlz");
+    else if (name == "mmap")
+        sink = std::make_shared<wlog::MmapSink>(opt.dir + "/mmap-");
+    else if (name == "fd-batch")
+        sink = std::make_shared<wlog::FdSink>(opt.dir + "/fd-batch.log",
+                                              wlog::SyncPolicy::perBatch());
+    else
+        return nullptr;
+    if (opt.slow_sink_us > 0)
+        sink = std::make_shared<SlowSink>(sink, opt.slow_sink_us);
+    return sink;
+}
+
+// 工作器类型：sync / safe / unsafe / ring-safe / ring-unsafe / deferred /
+//             drop-newest / drop-oldest / block-timeout / drop-below /
+//             shared / ring-shared (使用共享线程池) /
+//             parallel (4个线程并行格式化) /
+//             spin / yield (消费者忙等或自旋后让出CPU) /
+//             eager (每条日志都唤醒消费者，用于对比唤醒合并的效果) /
+//             metrics (开启内置统计，与safe对比统计本身的开销)
+bool configureLooper(wlog::LoggerBuilder& builder, const std::string& name) {
+    if (name == "sync") {
+        builder.buildType(wlog::LoggerType::SYNC);
+        return true;
+    }
+    builder.buildType(wlog::LoggerType::ASYNC);
+    if (name == "safe") return true;
+    if (name == "unsafe") {
+        builder.enableUnsafeAsync();
+        return true;
+    }
+    if (name == "ring-safe") {
+        builder.enableRingLooper();
+        return true;
+    }
+    if (name == "ring-unsafe") {
+        builder.enableUnsafeAsync();
+        builder.enableRingLooper();
+        return true;
+    }
+    if (name == "deferred") {
+        builder.enableDeferredFormat();
+        return true;
+    }
+    if (name == "drop-newest") {
+        builder.buildOverflowPolicy(wlog::LooperType::DROP_NEWEST);
+        return true;
+    }
+    if (name == "drop-oldest") {
+        builder.buildOverflowPolicy(wlog::LooperType::DROP_OLDEST);
+        return true;
+    }
+    if (name == "block-timeout") {
+        builder.buildOverflowPolicy(wlog::LooperType::BLOCK_TIMEOUT);
+        return true;
+    }
+    if (name == "drop-below") {
+        builder.buildOverflowPolicy(wlog::LooperType::DROP_BELOW_LEVEL);
+        return true;
+    }
+    if (name == "shared") {
+        builder.enableSharedBackend();
+        return true;
+    }
+    if (name == "ring-shared") {
+        builder.enableRingLooper();
+        builder.enableSharedBackend();
+        return true;
+    }
+    if (name == "parallel") {
+        builder.enableParallelFormat(4);
+        return true;
+    }
+    if (name == "spin") {
+        builder.buildIdleStrategy(wlog::IdleStrategy::BUSY_SPIN);
+        return true;
+    }
+    if (name == "yield") {
+        builder.buildIdleStrategy(wlog::IdleStrategy::SPIN_YIELD);
+        return true;
+    }
+    if (name == "eager") {
+        builder.buildWakeThreshold(0);
+        return true;
+    }
+    if (name == "metrics") {
+        builder.enableMetrics();
+        return true;
+    }
+    return false;
+}
+
+bool runOne(const Options& opt, Result& res) {
+    wlog::Logger::ptr logger;
+    {
+        wlog::LocalLoggerBuilder builder;
+        builder.buildName("latency_logger");
+        builder.buildFommatter(patternOf(res.pattern));
+        if (!configureLooper(builder, res.looper)) {
+            std::cerr << "未知的工作器类型: " << res.looper << std::endl;
+            return false;
+        }
+        wlog::LogSink::ptr sink = createSink(opt, res.sink);
+        if (!sink) {
+            std::cerr << "未知的落地方向: " << res.sink << std::endl;
+            return false;
+        }
+        builder.buildSink(sink);
+        builder.buildBufferCount(opt.buffers);
+        logger = builder.build();
+    }
+
+    std::string msg(res.size > 1 ? res.size - 1 : 1, 'a');
+    size_t per_thread = opt.count / res.threads;
+    std::vector<Histogram> hists(res.threads);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < res.threads; i++) {
+        threads.emplace_back([&, i]() {
+            Histogram& hist = hists[i];
+            for (size_t j = 0; j < per_thread; j++) {
+                auto t0 = std::chrono::steady_clock::now();
+                logger->info("%s", msg.c_str());
+                auto t1 = std::chrono::steady_clock::now();
+                hist.record(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(t1 -
+                                                                         t0)
+                        .count());
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    auto end = std::chrono::steady_clock::now();
+    res.seconds = std::chrono::duration<double>(end - start).count();
+    for (auto& hist : hists) res.hist.merge(hist);
+    auto async_logger = std::dynamic_pointer_cast<wlog::AsyncLogger>(logger);
+    if (async_logger) res.peak_inflight = async_logger->peakInflightBuffers();
+    // 销毁日志器之前取快照，此时落地尚未全部完成
+    wlog::MetricsSnapshot metrics = logger->metrics();
+    if (metrics.enabled) {
+        std::cerr << "  metrics: enqueue p99="
+                  << metrics.enqueue_ns.percentile(0.99) << "ns blocked=" << metrics.blocked_ns.count
+                  << " batch mean=" << (uint64_t)metrics.batch_bytes.mean()
+                  << "B format mean=" << (uint64_t)metrics.format_ns.mean()
+                  << "ns sink write mean="
+                  << (uint64_t)metrics.sinks[0].write_ns.mean() << "ns "
+                  << (uint64_t)(metrics.sinks[0].bytes_per_sec / 1024 / 1024)
+                  << "MB/s" << std::endl;
+    }
+    // 销毁日志器，等待异步数据全部落地后再开始下一组
+    logger.reset();
+    return true;
+}
+
+void writeCsv(std::ostream& out, const std::vector<Result>& results) {
+    out << "threads,msg_size,pattern,sink,looper,slow_sink_us,count,"
+           "seconds,msgs_per_sec,mean_ns,p50_ns,p99_ns,p999_ns,max_ns\n";
+    for (auto& r : results) {
+        out << r.threads << "," << r.size << ",\"" << r.pattern << "\","
+            << r.sink << "," << r.looper << "," << r.slow_sink_us << ","
+            << r.hist.count() << "," << r.seconds << ","
+            << (uint64_t)(r.hist.count() / r.seconds) << ","
+            << (uint64_t)r.hist.mean() << "," << r.hist.percentile(0.5) << ","
+            << r.hist.percentile(0.99) << "," << r.hist.percentile(0.999)
+            << "," << r.hist.max() << "\n";
+    }
+}
+
+void writeJson(std::ostream& out, const std::vector<Result>& results) {
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        auto& r = results[i];
+        out << "  {\"threads\": " << r.threads << ", \"msg_size\": " << r.size
+            << ", \"pattern\": \"" << r.pattern << "\", \"sink\": \""
+            << r.sink << "\", \"looper\": \"" << r.looper
+            << "\", \"slow_sink_us\": " << r.slow_sink_us
+            << ", \"count\": " << r.hist.count()
+            << ", \"seconds\": " << r.seconds
+            << ", \"msgs_per_sec\": " << (uint64_t)(r.hist.count() / r.seconds)
+            << ", \"mean_ns\": " << (uint64_t)r.hist.mean()
+            << ", \"p50_ns\": " << r.hist.percentile(0.5)
+            << ", \"p99_ns\": " << r.hist.percentile(0.99)
+            << ", \"p999_ns\": " << r.hist.percentile(0.999)
+            << ", \"max_ns\": " << r.hist.max() << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "]\n";
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) return 1;
+    wlog::file::createDirectory(opt.dir + "/");
+
+    std::vector<Result> results;
+    for (size_t threads : opt.threads)
+        for (size_t size : opt.sizes)
+            for (auto& pattern : opt.patterns)
+                for (auto& sink : opt.sinks)
+                    for (auto& looper : opt.loopers) {
+                        Result res{threads, size,
+                                   pattern, sink,
+                                   looper,  opt.slow_sink_us,
+                                   Histogram(), 0,
+                                   0};
+                        if (!runOne(opt, res)) return 1;
+                        std::cerr << "threads=" << threads << " size=" << size
+                                  << " pattern=" << pattern
+                                  << " sink=" << sink << " looper=" << looper
+                                  << " p50=" << res.hist.percentile(0.5)
+                                  << "ns p99=" << res.hist.percentile(0.99)
+                                  << "ns max=" << res.hist.max() << "ns"
+                                  << " peak_inflight=" << res.peak_inflight
+                                  << std::endl;
+                        results.push_back(std::move(res));
+                    }
+
+    std::ofstream file;
+    if (!opt.out.empty()) file.open(opt.out);
+    std::ostream& out = opt.out.empty() ? std::cout : file;
+    if (opt.output == "csv")
+        writeCsv(out, results);
+    else
+        writeJson(out, results);
+    return 0;
+}
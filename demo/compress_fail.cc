@@ -0,0 +1,46 @@
+// 验证压缩结果写入失败时保留原文件
+//   压缩目标指向/dev/full，最后一部分数据在关闭时写出并失败(ENOSPC)，
+//   原日志文件必须保留，目标文件必须被删除
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+
+#include "../logs/compress.hpp"
+
+static bool exists(const std::string &path) {
+    struct stat st;
+    return lstat(path.c_str(), &st) == 0;
+}
+
+int main() {
+    const std::string src = "./compress_fail.log";
+    const std::string dst = src + ".wlz";
+    {
+        // 数据量小于ofstream的缓冲区，只在关闭时写出
+        std::ofstream ofs(src, std::ios::trunc);
+        for (int i = 0; i < 100; i++) ofs << "测试日志 " << i << "\n";
+    }
+    bool ok = !wlog::compressFile(src, "/dev/full");
+    std::cout << "compressFile写入/dev/full: " << (ok ? "返回失败" : "返回成功")
+              << std::endl;
+
+    std::remove(dst.c_str());
+    if (symlink("/dev/full", dst.c_str()) != 0) {
+        std::cout << "创建符号链接失败" << std::endl;
+        return 1;
+    }
+    {
+        wlog::BackgroundCompressor compressor;
+        compressor.add(src);
+    }  // 析构时处理完队列
+    bool kept = exists(src) && !exists(dst);
+    std::cout << "后台压缩失败后原文件" << (kept ? "保留" : "丢失")
+              << std::endl;
+    ok = ok && kept;
+    std::remove(src.c_str());
+    std::remove(dst.c_str());
+    std::cout << (ok ? "通过" : "失败") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -10,6 +10,8 @@ void test_root_logger() {
     WARNING("%d %s", 3, str.c_str());
     ERROR("%d %s", 4, str.c_str());
     FATAL("%d %s", 5, str.c_str());
+    // 结构化字段，格式中没有%k时以logfmt形式跟在消息之后
+    INFO_KV("字段示例", wlog::kv("id", 6), wlog::kv("msg", str));
 }
 
 // 按照配置的选项进行输出
@@ -24,9 +26,18 @@ void test_log(const std::string logger_name) {
     logger->fatal("%d %s", 5, str.c_str());
 }
 
+// 按名称缓存的日志器：注册之前的调用被跳过，注册之后正常输出
+void test_cached_logger(const std::string &stage) {
+    WLOG_WARNING(WLOG_LOGGER("async_logger"), "缓存的日志器 %s",
+                 stage.c_str());
+    // 从未注册的名称，调用被跳过
+    WLOG_ERROR(WLOG_LOGGER("not_registered"), "不会输出 %d", 1);
+}
+
 int main() {
     // 默认日志输出
     test_root_logger();
+    test_cached_logger("注册之前");
 
     std::unique_ptr<wlog::LoggerBuilder> builder =
         std::make_unique<wlog::GlobalLoggerBuilder>();
@@ -50,6 +61,7 @@ int main() {
     builder->build();
 
     test_log("async_logger");
+    test_cached_logger("注册之后");
 
     return 0;
 }
@@ -0,0 +1,46 @@
+// 解压CompressSink或RollSinkBySize后台压缩生成的文件，输出到标准输出
+//   用法：./wlzcat file.wlz [file2.wlz ...]
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "../logs/compress.hpp"
+
+bool cat(const char *filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs.is_open()) {
+        std::cerr << "打开文件失败: " << filename << std::endl;
+        return false;
+    }
+    // 按块流式解压，不完整的块留到下一次读取之后
+    std::vector<char> chunk(1024 * 1024);
+    std::string pending;
+    std::string out;
+    while (ifs) {
+        ifs.read(chunk.data(), chunk.size());
+        pending.append(chunk.data(), ifs.gcount());
+        out.clear();
+        size_t used = 0;
+        bool ok = wlog::BlockCodec::decompress(pending.data(), pending.size(),
+                                               out, used);
+        std::cout.write(out.data(), out.size());
+        pending.erase(0, used);
+        if (!ok) break;
+    }
+    if (!pending.empty()) {
+        std::cerr << filename << ": 剩余" << pending.size()
+                  << "字节无法解压(文件损坏或不完整)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "用法: " << argv[0] << " file.wlz [...]" << std::endl;
+        return 1;
+    }
+    bool ok = true;
+    for (int i = 1; i < argc; i++) ok = cat(argv[i]) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+// 验证日志热路径预热之后不再申请内存
+//   通过替换malloc系列函数统计调用次数，申请次数不为0时返回失败
+#include <malloc.h>
+
+#include <atomic>
+#include <cstdlib>
+
+#include "../logs/wlog.h"
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t align, size_t size);
+
+static std::atomic<size_t> g_alloc_count(0);
+static std::atomic<bool> g_counting(false);
+
+static void countAlloc() {
+    if (g_counting.load(std::memory_order_relaxed))
+        g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+}
+void *malloc(size_t size) {
+    countAlloc();
+    return __libc_malloc(size);
+}
+void *calloc(size_t n, size_t size) {
+    countAlloc();
+    return __libc_calloc(n, size);
+}
+void *realloc(void *ptr, size_t size) {
+    countAlloc();
+    return __libc_realloc(ptr, size);
+}
+void *memalign(size_t align, size_t size) {
+    countAlloc();
+    return __libc_memalign(align, size);
+}
+int posix_memalign(void **ptr, size_t align, size_t size) {
+    countAlloc();
+    *ptr = __libc_memalign(align, size);
+    return *ptr == nullptr ? ENOMEM : 0;
+}
+void *aligned_alloc(size_t align, size_t size) {
+    countAlloc();
+    return __libc_memalign(align, size);
+}
+}
+
+// 丢弃所有数据，排除落地方式本身的影响
+class NullSink : public wlog::LogSink {
+public:
+    void log(const char * /*data*/, size_t len) override { _bytes += len; }
+    size_t _bytes = 0;
+};
+
+bool check(const std::string &logger_name, size_t count) {
+    wlog::Logger::ptr logger = wlog::getLogger(logger_name);
+    const std::string str = "测试日志";
+    // 预热：线程局部缓冲区、线程ID缓存、异步缓冲区
+    for (int i = 0; i < 1000; i++) {
+        logger->info("%d %s %f", i, str.c_str(), i * 0.5);
+    }
+    g_alloc_count = 0;
+    g_counting = true;
+    for (size_t i = 0; i < count; i++) {
+        logger->info("%d %s %f", (int)i, str.c_str(), i * 0.5);
+        logger->debug("%s", str.c_str());
+    }
+    g_counting = false;
+    size_t allocs = g_alloc_count.load();
+    std::cout << logger_name << ": " << count * 2 << " 条日志, 申请内存 "
+              << allocs << " 次" << std::endl;
+    return allocs == 0;
+}
+
+int main() {
+    std::unique_ptr<wlog::LoggerBuilder> builder =
+        std::make_unique<wlog::GlobalLoggerBuilder>();
+    builder->buildName("sync_logger");
+    builder->buildType(wlog::LoggerType::SYNC);
+    builder->buildSink<NullSink>();
+    builder->build();
+
+    builder = std::make_unique<wlog::GlobalLoggerBuilder>();
+    builder->buildName("async_logger");
+    builder->buildType(wlog::LoggerType::ASYNC);
+    builder->buildSink<NullSink>();
+    builder->build();
+
+    bool ok = check("sync_logger", 100000);
+    ok = check("async_logger", 100000) && ok;
+    std::cout << (ok ? "通过" : "失败") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+// 花括号格式：类型安全的变参模板格式化
+//   1. 格式串中的{}按顺序替换为参数，{{和}}分别输出{和}
+//   2. 说明符：{:x}/{:X}以十六进制输出整数，{:.N}以N位小数输出浮点数
+//   3. 整数和浮点数用std::to_chars直接转换，不经过printf
+//   4. 格式串为字面量时可以在编译期检查占位符数量和说明符类型，
+//      见wlog.h中的WLOG_xxx_FMT宏
+#pragma once
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace wlog {
+// 只用于在decltype中取出参数类型
+template <typename... Args>
+struct ArgTypes {};
+template <typename... Args>
+ArgTypes<typename std::decay<Args>::type...> argTypes(Args &&...);
+
+class BraceFormat {
+public:
+    // 参数类别，决定可以使用的说明符
+    enum class Kind { INT, FLOAT, BOOL, CHAR, STRING, POINTER, UNSUPPORTED };
+
+    template <typename T>
+    static constexpr Kind kindOf() {
+        using U = typename std::decay<T>::type;
+        if (std::is_same<U, bool>::value) return Kind::BOOL;
+        if (std::is_same<U, char>::value) return Kind::CHAR;
+        if (std::is_integral<U>::value || std::is_enum<U>::value)
+            return Kind::INT;
+        if (std::is_floating_point<U>::value) return Kind::FLOAT;
+        if (std::is_same<U, const char *>::value ||
+            std::is_same<U, char *>::value ||
+            std::is_same<U, std::string>::value ||
+            std::is_same<U, std::string_view>::value)
+            return Kind::STRING;
+        if (std::is_pointer<U>::value || std::is_null_pointer<U>::value)
+            return Kind::POINTER;
+        return Kind::UNSUPPORTED;
+    }
+
+    // 编译期检查：占位符数量与参数个数一致，说明符与参数类型匹配
+    template <typename... Args>
+    static constexpr bool check(const char *fmt, ArgTypes<Args...>) {
+        constexpr Kind kinds[] = {kindOf<Args>()..., Kind::UNSUPPORTED};
+        size_t index = 0;
+        const char *pos = fmt;
+        Spec spec;
+        while (true) {
+            int res = next(pos, spec);
+            if (res < 0) return false;
+            if (res == 0) break;
+            if (index >= sizeof...(Args)) return false;
+            if (!accepts(kinds[index], spec)) return false;
+            index++;
+        }
+        return index == sizeof...(Args);
+    }
+
+    // 按fmt格式化args并追加到out；
+    // 参数不足时多出的占位符原样输出，参数多余时忽略
+    template <typename... Args>
+    static void format(std::string &out, const char *fmt,
+                       const Args &...args) {
+        static_assert(((kindOf<Args>() != Kind::UNSUPPORTED) && ...),
+                      "不支持的参数类型");
+        const char *pos = fmt;
+        formatArgs(out, pos, args...);
+        // 剩余文本，占位符原样保留
+        Spec spec;
+        while (true) {
+            const char *begin = pos;
+            int res = next(pos, spec);
+            if (res <= 0) {
+                appendText(out, begin, res == 0 ? pos : begin + strlen(begin));
+                return;
+            }
+            appendText(out, begin, spec.text_end);
+            out.append(spec.text_end, pos - spec.text_end);
+        }
+    }
+
+private:
+    struct Spec {
+        const char *text_end = nullptr;  // 占位符之前的文本结尾
+        char type = '\0';                // 'x'、'X'，或'\0'
+        int precision = -1;              // -1表示未指定
+    };
+
+    // 从pos开始查找下一个占位符，返回1；到达结尾返回0；格式错误返回-1。
+    // 结尾时pos指向'\0'，占位符时pos指向'}'之后
+    static constexpr int next(const char *&pos, Spec &spec) {
+        const char *p = pos;
+        while (true) {
+            while (*p != '\0' && *p != '{' && *p != '}') p++;
+            if (*p == '\0') {
+                spec.text_end = p;
+                pos = p;
+                return 0;
+            }
+            if (p[1] == *p) {
+                // {{或}}
+                p += 2;
+                continue;
+            }
+            if (*p == '}') return -1;
+            break;
+        }
+        spec = Spec();
+        spec.text_end = p++;
+        if (*p == ':') {
+            p++;
+            if (*p == '.') {
+                p++;
+                if (*p < '0' || *p > '9') return -1;
+                spec.precision = 0;
+                while (*p >= '0' && *p <= '9') {
+                    spec.precision = spec.precision * 10 + (*p++ - '0');
+                    if (spec.precision > kMaxPrecision) return -1;
+                }
+            } else if (*p == 'x' || *p == 'X') {
+                spec.type = *p++;
+            }
+        }
+        if (*p != '}') return -1;
+        pos = p + 1;
+        return 1;
+    }
+
+    static constexpr bool accepts(Kind kind, const Spec &spec) {
+        if (kind == Kind::UNSUPPORTED) return false;
+        if (spec.type != '\0') return kind == Kind::INT;
+        if (spec.precision >= 0) return kind == Kind::FLOAT;
+        return true;
+    }
+
+    // 追加[begin, end)之间的文本，{{和}}还原为一个字符
+    static void appendText(std::string &out, const char *begin,
+                           const char *end) {
+        const char *p = begin;
+        while (p < end) {
+            if ((*p == '{' || *p == '}') && p + 1 < end && p[1] == *p) {
+                out.append(begin, p + 1 - begin);
+                p += 2;
+                begin = p;
+                continue;
+            }
+            p++;
+        }
+        out.append(begin, end - begin);
+    }
+
+    static void formatArgs(std::string &, const char *&) {}
+    template <typename T, typename... Rest>
+    static void formatArgs(std::string &out, const char *&pos, const T &arg,
+                           const Rest &...rest) {
+        const char *begin = pos;
+        Spec spec;
+        if (next(pos, spec) <= 0) {
+            pos = begin;
+            return;
+        }
+        appendText(out, begin, spec.text_end);
+        appendArg(out, spec, arg);
+        formatArgs(out, pos, rest...);
+    }
+
+    template <typename T>
+    static void appendArg(std::string &out, const Spec &spec, const T &arg) {
+        constexpr Kind kind = kindOf<T>();
+        if constexpr (kind == Kind::BOOL) {
+            out.append(arg ? "true" : "false");
+        } else if constexpr (kind == Kind::CHAR) {
+            out.push_back(arg);
+        } else if constexpr (kind == Kind::INT) {
+            // 统一为64位整数，覆盖字符类型和枚举
+            using U = typename std::conditional<
+                std::is_enum<T>::value, std::underlying_type<T>,
+                std::enable_if<true, T>>::type::type;
+            if constexpr (std::is_signed<U>::value) {
+                appendInt(out, spec, (long long)arg);
+            } else {
+                appendInt(out, spec, (unsigned long long)arg);
+            }
+        } else if constexpr (kind == Kind::FLOAT) {
+            appendFloat(out, spec, arg);
+        } else if constexpr (kind == Kind::STRING) {
+            if constexpr (std::is_pointer<T>::value ||
+                          std::is_array<T>::value) {
+                const char *str = arg;
+                out.append(str ? str : "(null)");
+            } else {
+                out.append(arg.data(), arg.size());
+            }
+        } else if constexpr (kind == Kind::POINTER) {
+            Spec hex;
+            hex.type = 'x';
+            out.append("0x");
+            appendInt(out, hex, (uintptr_t)(const void *)arg);
+        }
+    }
+
+    template <typename T>
+    static void appendInt(std::string &out, const Spec &spec, T value) {
+        char tmp[72];
+        int base = spec.type == '\0' ? 10 : 16;
+        auto res = std::to_chars(tmp, tmp + sizeof(tmp), value, base);
+        if (spec.type == 'X') {
+            for (char *p = tmp; p < res.ptr; p++)
+                if (*p >= 'a' && *p <= 'f') *p -= 'a' - 'A';
+        }
+        out.append(tmp, res.ptr - tmp);
+    }
+
+    template <typename T>
+    static void appendFloat(std::string &out, const Spec &spec, T value) {
+        // 足够容纳double的定点表示(最多309位整数) + 小数位
+        char tmp[kFloatBufSize];
+        std::to_chars_result res;
+        if (spec.precision >= 0) {
+            res = std::to_chars(tmp, tmp + sizeof(tmp), value,
+                                std::chars_format::fixed, spec.precision);
+            // long double的定点表示可能更长，退回到科学计数法
+            if (res.ec != std::errc())
+                res = std::to_chars(tmp, tmp + sizeof(tmp), value,
+                                    std::chars_format::scientific,
+                                    spec.precision);
+        } else {
+            res = std::to_chars(tmp, tmp + sizeof(tmp), value);
+        }
+        if (res.ec == std::errc()) out.append(tmp, res.ptr - tmp);
+    }
+
+    static constexpr int kMaxPrecision = 99;
+    static constexpr size_t kFloatBufSize = 512;
+};
+}  // namespace wlog
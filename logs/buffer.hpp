@@ -1,80 +1,236 @@
 // 异步日志缓冲
+//   1. 由固定大小的块组成，块来自全局空闲链表(ChunkPool)，分配时不清零
+//   2. 扩容只需要链接一个新块，不拷贝已有数据；swap只交换块列表，为O(1)
+//   3. 一次push的数据总在同一个块内(单条记录不跨块)，超过块大小时单独分配一个大块
+//   4. 读取时以iovec列表的形式交出各块的可读区域
+//   5. 构造时预先取得容量以内的块；reset时超出容量的块归还给空闲链表，
+//      空闲链表超过高水位后直接释放内存
 #pragma once
+#include <sys/uio.h>
+
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 #include <vector>
 
 namespace wlog {
 #define DEFAULT_BUFFER_SIZE (1 * 1024 * 1024)
-#define THRESHOLD_BUFFER_SIZE (8 * 1024 * 1024)
-#define INCREASEMENT_BUFFER_SIZE (1 * 1024 * 1024)
+#define BUFFER_CHUNK_SIZE (256 * 1024)
+#define DEFAULT_POOL_HIGH_WATER (16 * 1024 * 1024)
+
+struct BufferChunk {
+    BufferChunk(size_t size) : data(new char[size]), capacity(size), used(0) {}
+    ~BufferChunk() { delete[] data; }
+    char *data;
+    size_t capacity;
+    size_t used;  // 已写入的长度
+};
+
+// 全局的块空闲链表
+class ChunkPool {
+public:
+    // 有意不析构，保证进程退出阶段其他静态对象中的缓冲区仍可归还块
+    static ChunkPool &getInstance() {
+        static ChunkPool *pool = new ChunkPool();
+        return *pool;
+    }
+
+    BufferChunk *acquire(size_t len) {
+        if (len > BUFFER_CHUNK_SIZE) return new BufferChunk(len);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_free.empty()) {
+                BufferChunk *chunk = _free.back();
+                _free.pop_back();
+                chunk->used = 0;
+                return chunk;
+            }
+        }
+        return new BufferChunk(BUFFER_CHUNK_SIZE);
+    }
+
+    void release(BufferChunk *chunk) {
+        if (chunk->capacity == BUFFER_CHUNK_SIZE) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if ((_free.size() + 1) * BUFFER_CHUNK_SIZE <= _high_water) {
+                _free.push_back(chunk);
+                return;
+            }
+        }
+        delete chunk;
+    }
+
+    // 空闲链表保留的最大字节数，超出部分直接释放
+    void setHighWaterMark(size_t bytes) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _high_water = bytes;
+        while (!_free.empty() &&
+               _free.size() * BUFFER_CHUNK_SIZE > _high_water) {
+            delete _free.back();
+            _free.pop_back();
+        }
+    }
+
+    // 空闲链表中的字节数
+    size_t idleBytes() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _free.size() * BUFFER_CHUNK_SIZE;
+    }
+
+private:
+    ChunkPool() : _high_water(DEFAULT_POOL_HIGH_WATER) {}
+
+    std::mutex _mutex;
+    size_t _high_water;
+    std::vector<BufferChunk *> _free;
+};
 
 class Buffer {
 public:
-    Buffer() : _buffer(DEFAULT_BUFFER_SIZE), _writer_idx(0), _reader_idx(0) {}
+    // capacity为软上限：writeableSize按它计算，push本身总能成功
+    Buffer(size_t capacity = DEFAULT_BUFFER_SIZE)
+        : _capacity(capacity),
+          _read_chunk(0),
+          _read_pos(0),
+          _write_chunk(0),
+          _readable(0) {
+        _chunks.reserve(keepChunks() * 2);
+        for (size_t i = 0; i < keepChunks(); i++)
+            _chunks.push_back(ChunkPool::getInstance().acquire(0));
+    }
+    ~Buffer() {
+        for (auto chunk : _chunks) ChunkPool::getInstance().release(chunk);
+    }
+    Buffer(const Buffer &) = delete;
+    Buffer &operator=(const Buffer &) = delete;
 
     // 向缓冲区写入数据
     void push(const char *data, size_t len) {
-        expandSize(len);
+        memcpy(reserve(len), data, len);
+        commit(len);
+    }
 
-        std::copy(data, data + len, &_buffer[_writer_idx]);
-        moveWriter(len);
+    // 返回一段至少len字节的连续可写空间，写入后调用commit(len)
+    char *reserve(size_t len) {
+        while (roomOf(_write_chunk) < len && _write_chunk + 1 < _chunks.size())
+            _write_chunk++;
+        if (roomOf(_write_chunk) < len) {
+            _chunks.push_back(ChunkPool::getInstance().acquire(len));
+            _write_chunk = _chunks.size() - 1;
+        }
+        return _chunks[_write_chunk]->data + _chunks[_write_chunk]->used;
+    }
+    void commit(size_t len) {
+        assert(roomOf(_write_chunk) >= len);
+        _chunks[_write_chunk]->used += len;
+        _readable += len;
     }
 
-    // 返回可读数据的起始地址
-    const char *begin() { return &_buffer[_reader_idx]; }
+    // 以iovec列表的形式返回全部可读区域，每个区域内的记录都是完整的
+    void readv(std::vector<struct iovec> &iov) {
+        iov.clear();
+        for (size_t i = _read_chunk; i <= _write_chunk && i < _chunks.size();
+             i++) {
+            size_t begin = i == _read_chunk ? _read_pos : 0;
+            if (_chunks[i]->used == begin) continue;
+            struct iovec region;
+            region.iov_base = _chunks[i]->data + begin;
+            region.iov_len = _chunks[i]->used - begin;
+            iov.push_back(region);
+        }
+    }
 
     // 返回可读数据长度
-    size_t readableSize() { return _writer_idx - _reader_idx; }
+    size_t readableSize() { return _readable; }
 
-    // 返回可写数据长度
-    size_t writeableSize() { return _buffer.size() - _writer_idx; }
+    // 返回按容量计算的可写数据长度
+    size_t writeableSize() {
+        return _readable >= _capacity ? 0 : _capacity - _readable;
+    }
+
+    size_t capacity() { return _capacity; }
 
-    // 移动读指针
+    // 移动读指针，跳过各块末尾未使用的部分
     void moveReader(size_t len) {
         assert(len <= readableSize());
-        _reader_idx += len;
+        _readable -= len;
+        while (len > 0) {
+            size_t avail = _chunks[_read_chunk]->used - _read_pos;
+            if (avail == 0) {
+                _read_chunk++;
+                _read_pos = 0;
+                continue;
+            }
+            size_t n = std::min(len, avail);
+            _read_pos += n;
+            len -= n;
+        }
     }
 
-    // 重置读写位置
+    // 重置读写位置，只保留容量以内的块
     void reset() {
-        _reader_idx = 0;
-        _writer_idx = 0;
+        size_t keep = keepChunks();
+        for (size_t i = 0; i < _chunks.size(); i++) {
+            if (i < keep && _chunks[i]->capacity == BUFFER_CHUNK_SIZE) {
+                _chunks[i]->used = 0;
+            } else {
+                ChunkPool::getInstance().release(_chunks[i]);
+                _chunks[i] = nullptr;
+            }
+        }
+        _chunks.erase(std::remove(_chunks.begin(), _chunks.end(), nullptr),
+                      _chunks.end());
+        _read_chunk = 0;
+        _read_pos = 0;
+        _write_chunk = 0;
+        _readable = 0;
+    }
+
+    // 将已读完的块归还给空闲链表，回收已读部分的空间
+    void compact() {
+        if (_chunks.empty()) return;
+        size_t done = _read_chunk;
+        if (_chunks[done]->used == _read_pos && done < _write_chunk) done++;
+        if (done == 0) return;
+        for (size_t i = 0; i < done; i++)
+            ChunkPool::getInstance().release(_chunks[i]);
+        _chunks.erase(_chunks.begin(), _chunks.begin() + done);
+        if (done > _read_chunk) _read_pos = 0;
+        _read_chunk = 0;
+        _write_chunk -= done;
     }
 
     // 交换
     void swap(Buffer &other) {
-        // 交换管理空间
-        _buffer.swap(other._buffer);
-        // 交换读写指针
-        std::swap(_reader_idx, other._reader_idx);
-        std::swap(_writer_idx, other._writer_idx);
+        _chunks.swap(other._chunks);
+        std::swap(_capacity, other._capacity);
+        std::swap(_read_chunk, other._read_chunk);
+        std::swap(_read_pos, other._read_pos);
+        std::swap(_write_chunk, other._write_chunk);
+        std::swap(_readable, other._readable);
     }
 
     // 判断缓冲区是否为空
-    bool empty() { return (_reader_idx == _writer_idx); }
+    bool empty() { return _readable == 0; }
 
 private:
-    // 移动写指针
-    void moveWriter(size_t len) {
-        assert(len <= writeableSize());
-        _writer_idx += len;
-    }
-
-    void expandSize(size_t len) {
-        if (writeableSize() >= len) return;
-        if (writeableSize() < THRESHOLD_BUFFER_SIZE)
-            _buffer.resize(_buffer.size() * 2);
-        else {
-            _buffer.resize(_buffer.size() + INCREASEMENT_BUFFER_SIZE);
-        }
+    size_t keepChunks() {
+        return std::max<size_t>(
+            1, (_capacity + BUFFER_CHUNK_SIZE - 1) / BUFFER_CHUNK_SIZE);
+    }
+    size_t roomOf(size_t index) {
+        if (index >= _chunks.size()) return 0;
+        return _chunks[index]->capacity - _chunks[index]->used;
     }
 
-private:
-    std::vector<char> _buffer;
-    size_t _reader_idx;
-    size_t _writer_idx;
+    std::vector<BufferChunk *> _chunks;
+    size_t _capacity;    // 软上限
+    size_t _read_chunk;  // 读位置所在的块
+    size_t _read_pos;    // 读位置在块内的偏移
+    size_t _write_chunk;  // 写位置所在的块，之后的块都是空的
+    size_t _readable;    // 可读数据总长度
 };
 
 }  // namespace wlog
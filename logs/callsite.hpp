@@ -0,0 +1,283 @@
+// 调用点开关
+//   1. wlog.h中的WLOG_xxx宏为每个调用点生成一个静态描述符(文件、函数、行号、等级)，
+//      描述符是常量初始化的，没有静态局部变量的初始化检查
+//   2. 描述符带一个原子状态：DEFAULT按日志器的等级限制，ON强制输出，OFF强制关闭；
+//      检查只做一次relaxed读取，DEFAULT时再读取日志器的等级
+//   3. 描述符在第一次执行时登记，并按当前规则设置状态；之后修改规则会更新
+//      所有已登记的描述符，不需要重启
+//      日志器为空时直接跳过，不登记、不求值参数
+//   4. 规则可以通过接口设置，也可以由CallsiteWatcher监视本地控制文件
+// 规则格式：
+//   file.cc        该文件中的所有调用点(按路径后缀匹配)
+//   file.cc:120    该文件指定行的调用点
+//   @func          该函数中的所有调用点
+#pragma once
+#include <sys/stat.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "level.hpp"
+
+namespace wlog {
+enum class CallsiteState : uint8_t {
+    UNREGISTERED = 0,  // 还没有执行过
+    DEFAULT,           // 按日志器的等级限制
+    ON,                // 忽略等级限制，总是输出
+    OFF                // 总是不输出
+};
+
+class Callsite {
+public:
+    constexpr Callsite(const char *file, const char *func, size_t line,
+                       LogLevel::Value level)
+        : _file(file),
+          _func(func),
+          _line(line),
+          _level(level),
+          _state(CallsiteState::UNREGISTERED) {}
+
+    // logger为Logger::ptr或Logger*，为空(例如日志器尚未注册)时不输出
+    template <typename LoggerPtr>
+    bool enabled(const LoggerPtr &logger) {
+        if (!logger) return false;
+        CallsiteState state = _state.load(std::memory_order_relaxed);
+        if (state == CallsiteState::OFF) return false;
+        if (state == CallsiteState::ON) return true;
+        if (state == CallsiteState::UNREGISTERED) {
+            state = registerSelf();
+            if (state != CallsiteState::DEFAULT)
+                return state == CallsiteState::ON;
+        }
+        return logger->shouldLog(_level);
+    }
+
+    const char *file() const { return _file; }
+    const char *func() const { return _func; }
+    size_t line() const { return _line; }
+    LogLevel::Value level() const { return _level; }
+    CallsiteState state() const {
+        return _state.load(std::memory_order_relaxed);
+    }
+
+private:
+    friend class CallsiteRegistry;
+    inline CallsiteState registerSelf();
+
+    const char *_file;
+    const char *_func;
+    size_t _line;
+    LogLevel::Value _level;
+    std::atomic<CallsiteState> _state;
+};
+
+// 所有已执行过的调用点及开关规则(进程内唯一)
+class CallsiteRegistry {
+public:
+    static CallsiteRegistry &getInstance() {
+        // 不析构，静态对象析构期间执行到的调用点仍可登记
+        static CallsiteRegistry *reg = new CallsiteRegistry();
+        return *reg;
+    }
+
+    // 追加一条规则，后加入的规则优先；spec格式见文件开头
+    void set(const std::string &spec, CallsiteState state) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _rules.push_back(parseRule(spec, state));
+        applyAll();
+    }
+    // 清除所有规则，调用点恢复为DEFAULT
+    void reset() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _rules.clear();
+        applyAll();
+    }
+    // 用一组规则整体替换当前规则
+    using RuleList = std::vector<std::pair<std::string, CallsiteState>>;
+    void replace(const RuleList &rules) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _rules.clear();
+        for (auto &rule : rules)
+            _rules.push_back(parseRule(rule.first, rule.second));
+        applyAll();
+    }
+
+    // 遍历已登记的调用点
+    void forEach(const std::function<void(const Callsite &)> &fn) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (Callsite *callsite : _callsites) fn(*callsite);
+    }
+
+private:
+    friend class Callsite;
+
+    struct Rule {
+        std::string file;  // 路径后缀，空表示不限
+        std::string func;  // 函数名，空表示不限
+        size_t line = 0;   // 0表示不限
+        CallsiteState state;
+    };
+
+    CallsiteRegistry() {}
+
+    static Rule parseRule(const std::string &spec, CallsiteState state) {
+        Rule rule;
+        rule.state = state;
+        if (!spec.empty() && spec[0] == '@') {
+            rule.func = spec.substr(1);
+            return rule;
+        }
+        rule.file = spec;
+        size_t colon = spec.find_last_of(':');
+        if (colon != std::string::npos && colon + 1 < spec.size() &&
+            spec.find_first_not_of("0123456789", colon + 1) ==
+                std::string::npos) {
+            rule.file = spec.substr(0, colon);
+            rule.line = std::stoul(spec.substr(colon + 1));
+        }
+        return rule;
+    }
+
+    static bool match(const Rule &rule, const Callsite &callsite) {
+        if (!rule.func.empty() && rule.func != callsite.func()) return false;
+        if (rule.line != 0 && rule.line != callsite.line()) return false;
+        if (!rule.file.empty()) {
+            size_t len = strlen(callsite.file());
+            if (len < rule.file.size()) return false;
+            const char *tail = callsite.file() + len - rule.file.size();
+            if (memcmp(tail, rule.file.data(), rule.file.size()) != 0)
+                return false;
+            // 后缀需要从路径分隔处开始，避免"a.cc"匹配"data.cc"
+            if (tail != callsite.file() && tail[-1] != '/' &&
+                rule.file[0] != '/')
+                return false;
+        }
+        return true;
+    }
+
+    // 持有_mutex时调用
+    void apply(Callsite &callsite) {
+        CallsiteState state = CallsiteState::DEFAULT;
+        for (auto &rule : _rules)
+            if (match(rule, callsite)) state = rule.state;
+        callsite._state.store(state, std::memory_order_relaxed);
+    }
+    void applyAll() {
+        for (Callsite *callsite : _callsites) apply(*callsite);
+    }
+
+    CallsiteState add(Callsite &callsite) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // 多个线程同时第一次执行同一调用点时只登记一次
+        if (callsite.state() == CallsiteState::UNREGISTERED)
+            _callsites.push_back(&callsite);
+        apply(callsite);
+        return callsite.state();
+    }
+
+    std::mutex _mutex;
+    std::vector<Callsite *> _callsites;
+    std::vector<Rule> _rules;
+};
+
+inline CallsiteState Callsite::registerSelf() {
+    return CallsiteRegistry::getInstance().add(*this);
+}
+
+// 监视控制文件，文件内容变化时用其中的规则替换当前规则；
+// 每行一条规则，on/off/default后接规则，#开头为注释，例如：
+//   on  server.cc
+//   off server.cc:88
+//   on  @handleRequest
+// 对象析构时停止监视，已生效的规则保持不变
+class CallsiteWatcher {
+public:
+    using ptr = std::unique_ptr<CallsiteWatcher>;
+
+    CallsiteWatcher(const std::string &path,
+                    std::chrono::milliseconds interval =
+                        std::chrono::milliseconds(1000))
+        : _path(path), _interval(interval), _stop(false) {
+        _thread = std::thread(&CallsiteWatcher::threadEntry, this);
+    }
+    ~CallsiteWatcher() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cond.notify_all();
+        _thread.join();
+    }
+
+private:
+    void threadEntry() {
+        struct timespec last_mtime = {0, 0};
+        off_t last_size = -1;
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (!_stop) {
+            struct stat st;
+            if (stat(_path.c_str(), &st) == 0) {
+                if (st.st_mtim.tv_sec != last_mtime.tv_sec ||
+                    st.st_mtim.tv_nsec != last_mtime.tv_nsec ||
+                    st.st_size != last_size) {
+                    last_mtime = st.st_mtim;
+                    last_size = st.st_size;
+                    load();
+                }
+            }
+            _cond.wait_for(lock, _interval, [this]() { return _stop; });
+        }
+    }
+
+    void load() {
+        std::ifstream ifs(_path);
+        if (!ifs.is_open()) return;
+        CallsiteRegistry::RuleList rules;
+        std::string line;
+        while (std::getline(ifs, line)) {
+            std::istringstream ss(line);
+            std::string action, spec;
+            if (!(ss >> action) || action[0] == '#') continue;
+            if (!(ss >> spec)) continue;
+            if (action == "on")
+                rules.emplace_back(spec, CallsiteState::ON);
+            else if (action == "off")
+                rules.emplace_back(spec, CallsiteState::OFF);
+            else if (action == "default")
+                rules.emplace_back(spec, CallsiteState::DEFAULT);
+        }
+        CallsiteRegistry::getInstance().replace(rules);
+    }
+
+    std::string _path;
+    std::chrono::milliseconds _interval;
+    bool _stop;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::thread _thread;
+};
+
+// 便捷接口
+inline void enableCallsites(const std::string &spec) {
+    CallsiteRegistry::getInstance().set(spec, CallsiteState::ON);
+}
+inline void disableCallsites(const std::string &spec) {
+    CallsiteRegistry::getInstance().set(spec, CallsiteState::OFF);
+}
+inline void resetCallsites() { CallsiteRegistry::getInstance().reset(); }
+inline CallsiteWatcher::ptr watchCallsiteFile(
+    const std::string &path,
+    std::chrono::milliseconds interval = std::chrono::milliseconds(1000)) {
+    return std::make_unique<CallsiteWatcher>(path, interval);
+}
+}  // namespace wlog
@@ -0,0 +1,317 @@
+// 日志分块压缩
+//   1. 自带的LZ4风格编码(与LZ4块格式相同)，不依赖外部库
+//   2. 每块独立编码，不引用其他块的数据，可以流式解压，也可以从任意块开始读取
+//   3. 块格式：魔数(4字节) + 原始长度(4字节) + 存储长度(4字节) + 数据，
+//      均为小端；存储长度最高位为1表示数据不可压缩，按原样存储
+//   4. BackgroundCompressor在低优先级的后台线程中压缩已关闭的日志文件；
+//      压缩结果关闭并fsync成功之后才删除原文件，写入失败时保留原文件
+#pragma once
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace wlog {
+#define DEFAULT_COMPRESS_BLOCK_SIZE (64 * 1024)
+
+class BlockCodec {
+public:
+    static constexpr uint32_t kMagic = 0x315A4C57;  // "WLZ1"
+    static constexpr uint32_t kStoredFlag = 0x80000000u;
+    static constexpr size_t kHeaderSize = 12;
+
+    BlockCodec() : _table(kHashSize, 0) {}
+
+    // 将data按block_size切分，逐块压缩后追加到out
+    void compress(const char *data, size_t len, std::string &out,
+                  size_t block_size = DEFAULT_COMPRESS_BLOCK_SIZE) {
+        while (len > 0) {
+            size_t n = std::min(len, block_size);
+            compressBlock(data, n, out);
+            data += n;
+            len -= n;
+        }
+    }
+
+    // 解压data中的全部完整块，追加到out，used为消耗的字节数；
+    // 遇到不完整的块时停止(等待更多数据)，数据损坏时返回false
+    static bool decompress(const char *data, size_t len, std::string &out,
+                           size_t &used) {
+        used = 0;
+        while (len - used >= kHeaderSize) {
+            const char *p = data + used;
+            uint32_t magic = readLE32(p);
+            uint32_t raw = readLE32(p + 4);
+            uint32_t stored = readLE32(p + 8);
+            bool is_stored = (stored & kStoredFlag) != 0;
+            stored &= ~kStoredFlag;
+            if (magic != kMagic) return false;
+            if (len - used - kHeaderSize < stored) break;
+            p += kHeaderSize;
+            if (is_stored) {
+                if (stored != raw) return false;
+                out.append(p, stored);
+            } else if (!decodeBlock(p, stored, raw, out)) {
+                return false;
+            }
+            used += kHeaderSize + stored;
+        }
+        return true;
+    }
+
+private:
+    static constexpr int kMinMatch = 4;
+    static constexpr size_t kLastLiterals = 5;  // 最后5个字节总是字面量
+    static constexpr size_t kMatchFindLimit = 12;  // 最后一个匹配的起点限制
+    static constexpr size_t kMaxOffset = 65535;
+    static constexpr int kHashLog = 14;
+    static constexpr size_t kHashSize = 1 << kHashLog;
+
+    static uint32_t read32(const char *p) {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        return v;
+    }
+    static uint32_t readLE32(const char *p) {
+        const unsigned char *u = (const unsigned char *)p;
+        return u[0] | (u[1] << 8) | (u[2] << 16) | ((uint32_t)u[3] << 24);
+    }
+    static void writeLE32(char *p, uint32_t v) {
+        p[0] = (char)(v & 0xff);
+        p[1] = (char)((v >> 8) & 0xff);
+        p[2] = (char)((v >> 16) & 0xff);
+        p[3] = (char)((v >> 24) & 0xff);
+    }
+    static uint32_t hash(uint32_t v) {
+        return (v * 2654435761u) >> (32 - kHashLog);
+    }
+
+    static void writeLength(std::string &out, size_t len) {
+        while (len >= 255) {
+            out.push_back((char)255);
+            len -= 255;
+        }
+        out.push_back((char)len);
+    }
+
+    static void writeSequence(std::string &out, const char *literal,
+                              size_t lit_len, size_t offset, size_t match_len) {
+        size_t ml = match_len - kMinMatch;
+        unsigned char token = (unsigned char)(
+            (std::min<size_t>(lit_len, 15) << 4) | std::min<size_t>(ml, 15));
+        out.push_back((char)token);
+        if (lit_len >= 15) writeLength(out, lit_len - 15);
+        out.append(literal, lit_len);
+        out.push_back((char)(offset & 0xff));
+        out.push_back((char)(offset >> 8));
+        if (ml >= 15) writeLength(out, ml - 15);
+    }
+
+    static void writeLastLiterals(std::string &out, const char *literal,
+                                  size_t lit_len) {
+        out.push_back((char)(std::min<size_t>(lit_len, 15) << 4));
+        if (lit_len >= 15) writeLength(out, lit_len - 15);
+        out.append(literal, lit_len);
+    }
+
+    void compressBlock(const char *src, size_t len, std::string &out) {
+        size_t header = out.size();
+        out.append(kHeaderSize, '\0');
+        size_t body = out.size();
+        encodeBlock(src, len, out);
+        size_t stored = out.size() - body;
+        uint32_t stored_field = (uint32_t)stored;
+        // 压缩后没有变小则原样存储
+        if (stored >= len) {
+            out.resize(body);
+            out.append(src, len);
+            stored_field = (uint32_t)len | kStoredFlag;
+        }
+        writeLE32(&out[header], kMagic);
+        writeLE32(&out[header + 4], (uint32_t)len);
+        writeLE32(&out[header + 8], stored_field);
+    }
+
+    // 贪心匹配：每个位置按前4字节哈希查找最近一次出现的位置
+    void encodeBlock(const char *src, size_t len, std::string &out) {
+        const char *anchor = src;
+        if (len < kMatchFindLimit + 1) {
+            writeLastLiterals(out, anchor, len);
+            return;
+        }
+        std::fill(_table.begin(), _table.end(), 0);
+        const char *ip = src;
+        const char *end = src + len;
+        const char *match_find_limit = end - kMatchFindLimit;
+        const char *match_limit = end - kLastLiterals;
+        while (ip < match_find_limit) {
+            uint32_t seq = read32(ip);
+            uint32_t h = hash(seq);
+            const char *ref = src + _table[h];
+            _table[h] = (uint32_t)(ip - src);
+            if (ref < ip && (size_t)(ip - ref) <= kMaxOffset &&
+                read32(ref) == seq) {
+                size_t match_len = kMinMatch;
+                while (ip + match_len < match_limit &&
+                       ref[match_len] == ip[match_len])
+                    match_len++;
+                writeSequence(out, anchor, ip - anchor, ip - ref, match_len);
+                ip += match_len;
+                anchor = ip;
+                continue;
+            }
+            // 长时间没有匹配时加大步长，加快跳过不可压缩的数据
+            ip += 1 + ((ip - anchor) >> 6);
+        }
+        writeLastLiterals(out, anchor, end - anchor);
+    }
+
+    static bool readLength(const unsigned char *&ip, const unsigned char *end,
+                           size_t &len) {
+        unsigned char b;
+        do {
+            if (ip >= end) return false;
+            b = *ip++;
+            len += b;
+        } while (b == 255);
+        return true;
+    }
+
+    static bool decodeBlock(const char *src, size_t len, size_t raw,
+                            std::string &out) {
+        const unsigned char *ip = (const unsigned char *)src;
+        const unsigned char *end = ip + len;
+        size_t base = out.size();
+        while (ip < end) {
+            unsigned char token = *ip++;
+            size_t lit_len = token >> 4;
+            if (lit_len == 15 && !readLength(ip, end, lit_len)) return false;
+            if ((size_t)(end - ip) < lit_len) return false;
+            if (out.size() - base + lit_len > raw) return false;
+            out.append((const char *)ip, lit_len);
+            ip += lit_len;
+            if (ip >= end) break;  // 最后一个序列只有字面量
+            if (end - ip < 2) return false;
+            size_t offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+            size_t match_len = token & 15;
+            if (match_len == 15 && !readLength(ip, end, match_len))
+                return false;
+            match_len += kMinMatch;
+            size_t pos = out.size();
+            if (offset == 0 || offset > pos - base) return false;
+            if (pos - base + match_len > raw) return false;
+            // 匹配区域与输出重叠时只能逐字节复制
+            if (offset >= match_len) {
+                out.append(out, pos - offset, match_len);
+            } else {
+                for (size_t i = 0; i < match_len; i++)
+                    out.push_back(out[pos - offset + i]);
+            }
+        }
+        return out.size() - base == raw;
+    }
+
+private:
+    std::vector<uint32_t> _table;  // 哈希表：4字节前缀 -> 块内位置
+};
+
+// 将文件内容落盘，成功返回true
+inline bool syncFile(const std::string &dst) {
+    int fd = ::open(dst.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+// 将文件src压缩为dst，dst关闭并落盘之后才返回true
+inline bool compressFile(const std::string &src, const std::string &dst,
+                         size_t block_size = DEFAULT_COMPRESS_BLOCK_SIZE) {
+    std::ifstream ifs(src, std::ios::binary);
+    std::ofstream ofs(dst, std::ios::binary | std::ios::trunc);
+    if (!ifs.is_open() || !ofs.is_open()) return false;
+    BlockCodec codec;
+    std::vector<char> in(block_size * 16);
+    std::string out;
+    while (ifs) {
+        ifs.read(in.data(), in.size());
+        size_t n = ifs.gcount();
+        if (n == 0) break;
+        out.clear();
+        codec.compress(in.data(), n, out, block_size);
+        ofs.write(out.data(), out.size());
+    }
+    if (ifs.bad()) return false;
+    // 缓冲中的最后一部分数据在关闭时才写出，需要在关闭之后判断
+    ofs.close();
+    return !ofs.fail() && syncFile(dst);
+}
+
+// 后台压缩线程：文件压缩为"原文件名.wlz"，成功后删除原文件；
+// 析构时处理完队列中剩余的文件
+class BackgroundCompressor {
+public:
+    BackgroundCompressor(size_t block_size = DEFAULT_COMPRESS_BLOCK_SIZE)
+        : _block_size(block_size),
+          _running(true),
+          _thread(&BackgroundCompressor::threadEntry, this) {}
+    ~BackgroundCompressor() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _running = false;
+        }
+        _cond.notify_all();
+        if (_thread.joinable()) _thread.join();
+    }
+
+    void add(const std::string &filename) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _files.push_back(filename);
+        }
+        _cond.notify_one();
+    }
+
+private:
+    void threadEntry() {
+        // 降低本线程的调度优先级，避免与日志工作线程争抢CPU
+        setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+        while (true) {
+            std::string filename;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cond.wait(lock, [&]() { return !_running || !_files.empty(); });
+                if (_files.empty()) break;
+                filename = _files.front();
+                _files.pop_front();
+            }
+            std::string dst = filename + ".wlz";
+            if (compressFile(filename, dst, _block_size))
+                std::remove(filename.c_str());
+            else
+                std::remove(dst.c_str());
+        }
+    }
+
+private:
+    size_t _block_size;
+    bool _running;  // 受_mutex保护
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::deque<std::string> _files;  // 等待压缩的文件
+    std::thread _thread;             // 最后初始化，保证线程启动时其他成员已就绪
+};
+}  // namespace wlog
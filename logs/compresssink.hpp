@@ -0,0 +1,72 @@
+// 落地方向：分块压缩文件
+//   1. 每批数据按block_size切分为独立的压缩块，格式见compress.hpp
+//   2. 压缩结果通过FdSink一次写入，持久化策略与FdSink相同
+//   3. 读取时用BlockCodec::decompress解压，可以从任意块的起始位置开始
+#pragma once
+#include <sys/uio.h>
+
+#include <atomic>
+#include <string>
+
+#include "buffer.hpp"
+#include "compress.hpp"
+#include "fdsink.hpp"
+#include "sink.hpp"
+
+namespace wlog {
+class CompressSink : public LogSink {
+public:
+    using ptr = std::shared_ptr<CompressSink>;
+    CompressSink(const std::string &pathname,
+                 size_t block_size = DEFAULT_COMPRESS_BLOCK_SIZE,
+                 const SyncPolicy &policy = SyncPolicy())
+        : _file(pathname, policy),
+          _block_size(block_size),
+          _raw_bytes(0),
+          _compressed_bytes(0) {}
+
+    void log(const char *data, size_t len) override {
+        _out.clear();
+        _codec.compress(data, len, _out, _block_size);
+        flush(len);
+    }
+
+    void logv(const struct iovec *iov, int iovcnt) override {
+        _out.clear();
+        size_t len = 0;
+        for (int i = 0; i < iovcnt; i++) {
+            _codec.compress((const char *)iov[i].iov_base, iov[i].iov_len,
+                            _out, _block_size);
+            len += iov[i].iov_len;
+        }
+        flush(len);
+    }
+
+    // 压缩前后的累计字节数
+    uint64_t rawBytes() const {
+        return _raw_bytes.load(std::memory_order_relaxed);
+    }
+    uint64_t compressedBytes() const {
+        return _compressed_bytes.load(std::memory_order_relaxed);
+    }
+    FdSinkStats stats() const { return _file.stats(); }
+
+private:
+    void flush(size_t raw_len) {
+        if (_out.empty()) return;
+        _file.log(_out.data(), _out.size());
+        _raw_bytes.store(rawBytes() + raw_len, std::memory_order_relaxed);
+        _compressed_bytes.store(compressedBytes() + _out.size(),
+                                std::memory_order_relaxed);
+        if (_out.capacity() > DEFAULT_BUFFER_SIZE * 4) std::string().swap(_out);
+    }
+
+private:
+    FdSink _file;
+    BlockCodec _codec;
+    size_t _block_size;
+    std::string _out;  // 一批数据的压缩结果
+    std::atomic<uint64_t> _raw_bytes;
+    std::atomic<uint64_t> _compressed_bytes;
+};
+}  // namespace wlog
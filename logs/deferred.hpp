@@ -0,0 +1,491 @@
+// 延迟格式化的日志记录
+//   1. 生产者只解析printf格式串，按说明符取出参数的原始值写入记录，不做文本转换
+//   2. 消费线程再次解析格式串，用记录中的参数逐个还原出有效消息
+//   3. 无法延迟处理的说明符(%n、%m、%ls、位置参数等)在生产者侧直接格式化
+//   4. 结构化日志的记录不带格式串，保存消息原文和编码后的字段(见fields.hpp)
+// 注意：记录中只保存file和fmt的指针，二者必须在日志落地之前保持有效(通常为字面量)
+#pragma once
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "fields.hpp"
+#include "level.hpp"
+#include "threadinfo.hpp"
+#include "util.hpp"
+
+namespace wlog {
+// printf格式说明符
+struct PrintfSpec {
+    enum class Arg { INT, UINT, DOUBLE, LDOUBLE, STRING, POINTER, UNSUPPORTED };
+    enum class Length { NONE, HH, H, L, LL, J, Z, T, BIG_L };
+
+    const char *begin = nullptr;  // 指向'%'
+    const char *end = nullptr;    // 指向转换字符之后
+    bool width_star = false;      // 宽度由参数给出
+    bool prec_star = false;       // 精度由参数给出
+    int precision = -1;           // 字面精度，-1表示未指定
+    Length length = Length::NONE;
+    Arg arg = Arg::UNSUPPORTED;
+
+    // 从pos开始查找下一个说明符，text_end返回其之前的普通文本结尾；
+    // %%作为普通文本返回，没有说明符时返回false
+    static bool next(const char *&pos, const char *&text_end,
+                     PrintfSpec &spec) {
+        const char *p = pos;
+        while (*p != '\0' && *p != '%') p++;
+        text_end = p;
+        if (*p == '\0') {
+            pos = p;
+            return false;
+        }
+        if (p[1] == '%') {
+            // 文本包含第一个%，跳过第二个
+            text_end = p + 1;
+            pos = p + 2;
+            spec = PrintfSpec();
+            spec.begin = spec.end = nullptr;
+            return true;
+        }
+        spec = PrintfSpec();
+        spec.begin = p++;
+        // 标志
+        while (*p != '\0' && strchr("-+ #0'", *p)) p++;
+        // 宽度
+        if (*p == '*') {
+            spec.width_star = true;
+            p++;
+        } else {
+            while (*p >= '0' && *p <= '9') p++;
+        }
+        if (*p == '$') {
+            // 位置参数无法按顺序取出
+            spec.arg = Arg::UNSUPPORTED;
+            spec.end = p;
+            pos = p;
+            return true;
+        }
+        // 精度
+        if (*p == '.') {
+            p++;
+            if (*p == '*') {
+                spec.prec_star = true;
+                p++;
+            } else {
+                spec.precision = 0;
+                while (*p >= '0' && *p <= '9')
+                    spec.precision = spec.precision * 10 + (*p++ - '0');
+            }
+        }
+        // 长度修饰
+        switch (*p) {
+            case 'h':
+                spec.length = (p[1] == 'h') ? Length::HH : Length::H;
+                p += (p[1] == 'h') ? 2 : 1;
+                break;
+            case 'l':
+                spec.length = (p[1] == 'l') ? Length::LL : Length::L;
+                p += (p[1] == 'l') ? 2 : 1;
+                break;
+            case 'q':
+                spec.length = Length::LL;
+                p++;
+                break;
+            case 'j':
+                spec.length = Length::J;
+                p++;
+                break;
+            case 'z':
+                spec.length = Length::Z;
+                p++;
+                break;
+            case 't':
+                spec.length = Length::T;
+                p++;
+                break;
+            case 'L':
+                spec.length = Length::BIG_L;
+                p++;
+                break;
+        }
+        // 转换字符
+        switch (*p) {
+            case 'd':
+            case 'i':
+                spec.arg = Arg::INT;
+                break;
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X':
+                spec.arg = Arg::UINT;
+                break;
+            case 'c':
+                spec.arg =
+                    spec.length == Length::NONE ? Arg::INT : Arg::UNSUPPORTED;
+                break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                spec.arg =
+                    spec.length == Length::BIG_L ? Arg::LDOUBLE : Arg::DOUBLE;
+                break;
+            case 's':
+                spec.arg = spec.length == Length::NONE ? Arg::STRING
+                                                       : Arg::UNSUPPORTED;
+                break;
+            case 'p':
+                spec.arg = Arg::POINTER;
+                break;
+            default:
+                // %n、%m以及未知的转换字符
+                spec.arg = Arg::UNSUPPORTED;
+                break;
+        }
+        if (*p != '\0') p++;
+        spec.end = p;
+        pos = p;
+        return true;
+    }
+};
+
+// 延迟格式化记录：记录头 + 按说明符顺序排列的参数
+//   整数统一保存为8字节，浮点保存为double/long double，
+//   字符串保存为4字节长度 + 内容 + '\0'
+class DeferredRecord {
+public:
+    enum Flag : uint8_t {
+        PREFORMATTED = 1,  // 参数无法延迟处理，记录中为已格式化的有效消息
+        FIELDS = 2,  // 结构化日志：4字节消息长度 + 消息 + 编码后的字段
+    };
+    struct Header {
+        uint32_t size;  // 整条记录的长度(含记录头)
+        uint8_t level;
+        uint8_t flags;
+        uint32_t line;
+        uint32_t nsec;
+        int32_t ktid;  // 内核线程ID
+        int64_t time;
+        std::thread::id tid;
+        const char *file;
+        const char *fmt;
+    };
+    // 单个说明符的最大长度，超过时退回生产者侧格式化
+    static constexpr size_t kMaxSpecLen = 32;
+
+    // va_list在部分平台上是数组类型，包一层才能安全地按引用传递
+    struct VaArgs {
+        va_list ap;
+    };
+
+    // 生产者：将一条日志编码后追加到out
+    static void encode(std::string &out, LogLevel::Value level,
+                       const char *file, size_t line, const char *fmt,
+                       va_list ap) {
+        size_t start = out.size();
+        Header header = makeHeader(level, file, line, fmt);
+        out.append((const char *)&header, sizeof(header));
+
+        VaArgs args;
+        va_copy(args.ap, ap);
+        bool ok = encodeArgs(out, fmt, args);
+        va_end(args.ap);
+        if (!ok) {
+            // 退回到生产者侧格式化
+            out.resize(start + sizeof(header));
+            header.flags |= PREFORMATTED;
+            char tmp[256];
+            va_list cp;
+            va_copy(cp, ap);
+            int n = vsnprintf(tmp, sizeof(tmp), fmt, cp);
+            va_end(cp);
+            if (n < 0) n = 0;
+            if ((size_t)n < sizeof(tmp)) {
+                out.append(tmp, n);
+            } else {
+                out.resize(start + sizeof(header) + n + 1);
+                vsnprintf(&out[start + sizeof(header)], n + 1, fmt, ap);
+                out.resize(start + sizeof(header) + n);
+            }
+        }
+        header.size = (uint32_t)(out.size() - start);
+        memcpy(&out[start], &header, sizeof(header));
+    }
+
+    // 生产者：将一条结构化日志编码后追加到out，消息和字段都按原样保存
+    static void encodeFields(std::string &out, LogLevel::Value level,
+                             const char *file, size_t line,
+                             std::string_view msg, const Field *fields,
+                             size_t count) {
+        size_t start = out.size();
+        Header header = makeHeader(level, file, line, nullptr);
+        header.flags |= FIELDS;
+        out.append((const char *)&header, sizeof(header));
+        put<uint32_t>(out, (uint32_t)msg.size());
+        out.append(msg.data(), msg.size());
+        FieldCodec::encode(out, fields, count);
+        header.size = (uint32_t)(out.size() - start);
+        memcpy(&out[start], &header, sizeof(header));
+    }
+
+    // 消费者：解码data起始处的一条记录，有效消息追加到payload，
+    // fields指向记录中编码后的字段(没有时为空)；
+    // 返回记录长度，数据不完整时返回0
+    static size_t decode(const char *data, size_t len, Header &header,
+                         std::string &payload, std::string_view &fields) {
+        fields = std::string_view();
+        if (len < sizeof(header)) return 0;
+        memcpy(&header, data, sizeof(header));
+        if (header.size < sizeof(header) || header.size > len) return 0;
+        const char *args = data + sizeof(header);
+        const char *args_end = data + header.size;
+        if (header.flags & FIELDS) {
+            uint32_t msg_len = get<uint32_t>(args, args_end);
+            if (args > args_end || msg_len > (size_t)(args_end - args))
+                return header.size;
+            payload.append(args, msg_len);
+            fields = std::string_view(args + msg_len,
+                                      args_end - args - msg_len);
+        } else if (header.flags & PREFORMATTED) {
+            payload.append(args, args_end - args);
+        } else {
+            decodeArgs(payload, header.fmt, args, args_end);
+        }
+        return header.size;
+    }
+
+private:
+    static Header makeHeader(LogLevel::Value level, const char *file,
+                             size_t line, const char *fmt) {
+        Header header;
+        header.size = 0;
+        header.level = (uint8_t)level;
+        header.flags = 0;
+        header.line = (uint32_t)line;
+        time_t sec;
+        date::preciseNow(sec, header.nsec);
+        header.time = (int64_t)sec;
+        header.tid = std::this_thread::get_id();
+        header.ktid = (int32_t)ThreadInfo::tid();
+        header.file = file;
+        header.fmt = fmt;
+        return header;
+    }
+
+    template <typename T>
+    static void put(std::string &out, T value) {
+        out.append((const char *)&value, sizeof(value));
+    }
+    template <typename T>
+    static T get(const char *&pos, const char *end) {
+        T value{};
+        if (pos + sizeof(T) <= end) memcpy(&value, pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    static int64_t takeInt(PrintfSpec::Length length, VaArgs &args) {
+        using Length = PrintfSpec::Length;
+        switch (length) {
+            case Length::L:
+                return va_arg(args.ap, long);
+            case Length::LL:
+                return va_arg(args.ap, long long);
+            case Length::J:
+                return va_arg(args.ap, intmax_t);
+            case Length::Z:
+            case Length::T:
+                return va_arg(args.ap, ptrdiff_t);
+            default:
+                return va_arg(args.ap, int);
+        }
+    }
+    static uint64_t takeUint(PrintfSpec::Length length, VaArgs &args) {
+        using Length = PrintfSpec::Length;
+        switch (length) {
+            case Length::L:
+                return va_arg(args.ap, unsigned long);
+            case Length::LL:
+                return va_arg(args.ap, unsigned long long);
+            case Length::J:
+                return va_arg(args.ap, uintmax_t);
+            case Length::Z:
+            case Length::T:
+                return va_arg(args.ap, size_t);
+            default:
+                return va_arg(args.ap, unsigned int);
+        }
+    }
+
+    static bool encodeArgs(std::string &out, const char *fmt, VaArgs &args) {
+        using Arg = PrintfSpec::Arg;
+        const char *pos = fmt;
+        const char *text_end;
+        PrintfSpec spec;
+        while (PrintfSpec::next(pos, text_end, spec)) {
+            if (spec.begin == nullptr) continue;  // %%
+            if (spec.arg == Arg::UNSUPPORTED) return false;
+            if ((size_t)(spec.end - spec.begin) >= kMaxSpecLen) return false;
+            int precision = spec.precision;
+            if (spec.width_star) put<int64_t>(out, va_arg(args.ap, int));
+            if (spec.prec_star) {
+                precision = va_arg(args.ap, int);
+                put<int64_t>(out, precision);
+            }
+            switch (spec.arg) {
+                case Arg::INT:
+                    put<int64_t>(out, takeInt(spec.length, args));
+                    break;
+                case Arg::UINT:
+                    put<uint64_t>(out, takeUint(spec.length, args));
+                    break;
+                case Arg::DOUBLE:
+                    put<double>(out, va_arg(args.ap, double));
+                    break;
+                case Arg::LDOUBLE:
+                    put<long double>(out, va_arg(args.ap, long double));
+                    break;
+                case Arg::POINTER:
+                    put<const void *>(out, va_arg(args.ap, const void *));
+                    break;
+                case Arg::STRING: {
+                    const char *str = va_arg(args.ap, const char *);
+                    if (str == nullptr) str = "(null)";
+                    size_t len = precision >= 0 ? strnlen(str, precision)
+                                                : strlen(str);
+                    put<uint32_t>(out, (uint32_t)len);
+                    out.append(str, len);
+                    out.push_back('\0');
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // 按照spec把value追加到out，宽度和精度参数由width/prec给出
+    template <typename T>
+    static void appendSpec(std::string &out, const PrintfSpec &spec,
+                           int width, int prec, T value) {
+        char spec_buf[kMaxSpecLen];
+        size_t spec_len = spec.end - spec.begin;
+        memcpy(spec_buf, spec.begin, spec_len);
+        spec_buf[spec_len] = '\0';
+        auto print = [&](char *buf, size_t size) {
+            if (spec.width_star && spec.prec_star)
+                return snprintf(buf, size, spec_buf, width, prec, value);
+            if (spec.width_star) return snprintf(buf, size, spec_buf, width, value);
+            if (spec.prec_star) return snprintf(buf, size, spec_buf, prec, value);
+            return snprintf(buf, size, spec_buf, value);
+        };
+        char tmp[128];
+        int n = print(tmp, sizeof(tmp));
+        if (n < 0) return;
+        if ((size_t)n < sizeof(tmp)) {
+            out.append(tmp, n);
+            return;
+        }
+        size_t old = out.size();
+        out.resize(old + n + 1);
+        print(&out[old], n + 1);
+        out.resize(old + n);
+    }
+
+    static void decodeArgs(std::string &out, const char *fmt, const char *pos,
+                           const char *end) {
+        using Arg = PrintfSpec::Arg;
+        using Length = PrintfSpec::Length;
+        const char *cur = fmt;
+        const char *text_end;
+        PrintfSpec spec;
+        while (true) {
+            const char *text_begin = cur;
+            bool more = PrintfSpec::next(cur, text_end, spec);
+            out.append(text_begin, text_end - text_begin);
+            if (!more) break;
+            if (spec.begin == nullptr) continue;  // %%
+            int width = spec.width_star ? (int)get<int64_t>(pos, end) : 0;
+            int prec = spec.prec_star ? (int)get<int64_t>(pos, end) : 0;
+            switch (spec.arg) {
+                case Arg::INT: {
+                    int64_t v = get<int64_t>(pos, end);
+                    switch (spec.length) {
+                        case Length::L:
+                            appendSpec(out, spec, width, prec, (long)v);
+                            break;
+                        case Length::LL:
+                            appendSpec(out, spec, width, prec, (long long)v);
+                            break;
+                        case Length::J:
+                            appendSpec(out, spec, width, prec, (intmax_t)v);
+                            break;
+                        case Length::Z:
+                        case Length::T:
+                            appendSpec(out, spec, width, prec, (ptrdiff_t)v);
+                            break;
+                        default:
+                            appendSpec(out, spec, width, prec, (int)v);
+                            break;
+                    }
+                    break;
+                }
+                case Arg::UINT: {
+                    uint64_t v = get<uint64_t>(pos, end);
+                    switch (spec.length) {
+                        case Length::L:
+                            appendSpec(out, spec, width, prec, (unsigned long)v);
+                            break;
+                        case Length::LL:
+                            appendSpec(out, spec, width, prec,
+                                       (unsigned long long)v);
+                            break;
+                        case Length::J:
+                            appendSpec(out, spec, width, prec, (uintmax_t)v);
+                            break;
+                        case Length::Z:
+                        case Length::T:
+                            appendSpec(out, spec, width, prec, (size_t)v);
+                            break;
+                        default:
+                            appendSpec(out, spec, width, prec, (unsigned int)v);
+                            break;
+                    }
+                    break;
+                }
+                case Arg::DOUBLE:
+                    appendSpec(out, spec, width, prec, get<double>(pos, end));
+                    break;
+                case Arg::LDOUBLE:
+                    appendSpec(out, spec, width, prec,
+                               get<long double>(pos, end));
+                    break;
+                case Arg::POINTER:
+                    appendSpec(out, spec, width, prec,
+                               get<const void *>(pos, end));
+                    break;
+                case Arg::STRING: {
+                    uint32_t len = get<uint32_t>(pos, end);
+                    if (pos + len + 1 > end) return;
+                    appendSpec(out, spec, width, prec, pos);
+                    pos += len + 1;
+                    break;
+                }
+                default:
+                    return;
+            }
+        }
+    }
+};
+}  // namespace wlog
@@ -0,0 +1,96 @@
+// 共享的异步工作线程池
+//   1. 多个工作器(Looper)共用固定数量的后台线程，不再各自占用一个线程
+//   2. 有数据的工作器进入就绪队列，后台线程每次取出一个工作器只处理一批数据，
+//      仍有数据则重新排到队尾，保证各日志器之间公平轮转
+//   3. 同一个工作器同一时刻只会被一个后台线程处理，保证落地顺序
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace wlog {
+// 可以被线程池调度的任务
+class ExecutorTask {
+public:
+    virtual ~ExecutorTask() {}
+    // 处理一批数据，返回true表示仍有数据需要再次调度
+    virtual bool runBatch() = 0;
+};
+
+class LooperExecutor {
+public:
+    using ptr = std::shared_ptr<LooperExecutor>;
+
+    LooperExecutor(size_t thread_count) : _running(true) {
+        if (thread_count == 0) thread_count = 1;
+        for (size_t i = 0; i < thread_count; i++)
+            _threads.emplace_back(&LooperExecutor::threadEntry, this);
+    }
+    ~LooperExecutor() { stop(); }
+
+    // 任务有数据时调用；调用方负责保证同一任务不会重复进入队列。
+    // 线程池已停止时(例如进程退出阶段)直接在调用线程中处理
+    void schedule(const std::weak_ptr<ExecutorTask>& task) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_running) {
+                _ready.push_back(task);
+                _cond.notify_one();
+                return;
+            }
+        }
+        auto locked = task.lock();
+        if (locked) {
+            while (locked->runBatch()) {
+            }
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_running) return;
+            _running = false;
+        }
+        _cond.notify_all();
+        for (auto& thread : _threads) {
+            // 最后一个引用可能在后台线程中释放，此时不能等待自己
+            if (thread.get_id() == std::this_thread::get_id())
+                thread.detach();
+            else if (thread.joinable())
+                thread.join();
+        }
+    }
+
+    size_t threadCount() const { return _threads.size(); }
+
+private:
+    void threadEntry() {
+        while (true) {
+            std::shared_ptr<ExecutorTask> task;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cond.wait(lock, [&]() { return !_running || !_ready.empty(); });
+                // 退出前处理完已就绪的任务
+                if (_ready.empty()) break;
+                task = _ready.front().lock();
+                _ready.pop_front();
+            }
+            // 任务已被销毁则跳过
+            if (!task) continue;
+            if (task->runBatch()) schedule(task);
+        }
+    }
+
+private:
+    bool _running;  // 受_mutex保护
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::deque<std::weak_ptr<ExecutorTask>> _ready;  // 就绪队列
+    std::vector<std::thread> _threads;
+};
+}  // namespace wlog
@@ -0,0 +1,289 @@
+// 基于文件描述符的落地方向
+//   1. 直接write/writev到O_APPEND打开的文件，不经过ofstream的用户态缓冲
+//   2. 多段数据(例如多批格式化结果)用一次writev聚集写入
+//   3. 持久化策略：
+//        NONE: 不主动同步，由内核回写
+//        INTERVAL: 未同步数据达到sync_bytes，或其中最早的数据写入已超过
+//                  sync_interval时，由后台线程fdatasync一次，多批数据共用一次
+//                  同步(组提交)；之后没有新数据也会按时同步，因此写入的数据
+//                  最迟在sync_interval(加一次fdatasync的耗时)之后落盘；
+//                  同步在锁外进行，写入不等待同步
+//        PER_BATCH: 每次log/logv(异步日志器中即每批数据)之后fdatasync
+//   4. 写入和同步的耗时统计通过stats()读取
+//   5. 写入失败不会中断程序：记录错误次数，下次写入时重新打开文件
+#pragma once
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "sink.hpp"
+#include "util.hpp"
+
+namespace wlog {
+// 持久化策略
+struct SyncPolicy {
+    enum class Mode { NONE, INTERVAL, PER_BATCH };
+
+    SyncPolicy(Mode sync_mode = Mode::NONE,
+               size_t bytes = 4 * 1024 * 1024,
+               std::chrono::milliseconds interval =
+                   std::chrono::milliseconds(1000))
+        : mode(sync_mode), sync_bytes(bytes), sync_interval(interval) {}
+
+    static SyncPolicy none() { return SyncPolicy(Mode::NONE); }
+    static SyncPolicy perBatch() { return SyncPolicy(Mode::PER_BATCH); }
+    static SyncPolicy interval(size_t bytes,
+                               std::chrono::milliseconds interval) {
+        return SyncPolicy(Mode::INTERVAL, bytes, interval);
+    }
+
+    Mode mode;
+    size_t sync_bytes;                        // INTERVAL：未同步字节数上限
+    std::chrono::milliseconds sync_interval;  // INTERVAL：数据写入到同步的最长间隔
+};
+
+// 写入与同步的统计，单位为纳秒
+struct FdSinkStats {
+    uint64_t writes = 0;  // write/writev调用次数
+    uint64_t write_bytes = 0;
+    uint64_t write_ns = 0;  // 累计写入耗时
+    uint64_t write_max_ns = 0;
+    uint64_t syncs = 0;  // fdatasync次数
+    uint64_t sync_ns = 0;
+    uint64_t sync_max_ns = 0;
+    uint64_t errors = 0;  // 打开、写入或同步失败的次数
+};
+
+class FdSink : public LogSink {
+public:
+    using ptr = std::shared_ptr<FdSink>;
+    FdSink(const std::string &pathname,
+           const SyncPolicy &policy = SyncPolicy())
+        : _pathname(pathname),
+          _policy(policy),
+          _fd(-1),
+          _unsynced(0),
+          _sync_epoch(0),
+          _stop(false) {
+        wlog::file::createDirectory(wlog::file::path(_pathname));
+        openFile();
+        if (_policy.mode == SyncPolicy::Mode::INTERVAL)
+            _syncer = std::thread(&FdSink::syncEntry, this);
+    }
+    ~FdSink() {
+        if (_syncer.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _cond.notify_all();
+            _syncer.join();
+        }
+        if (_fd < 0) return;
+        if (_policy.mode != SyncPolicy::Mode::NONE && _unsynced > 0) sync();
+        ::close(_fd);
+    }
+
+    void log(const char *data, size_t len) override {
+        struct iovec iov;
+        iov.iov_base = const_cast<char *>(data);
+        iov.iov_len = len;
+        logv(&iov, 1);
+    }
+
+    void logv(const struct iovec *iov, int iovcnt) override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_fd < 0 && !openFile()) {
+            bump(_errors);
+            return;
+        }
+        size_t total = 0;
+        for (int i = 0; i < iovcnt; i++) total += iov[i].iov_len;
+        if (total == 0) return;
+        auto start = std::chrono::steady_clock::now();
+        bool ok = writeAll(iov, iovcnt);
+        recordLatency(_writes, _write_ns, _write_max_ns, start);
+        bump(_write_bytes, total);
+        if (!ok) {
+            // 下次写入时重新打开，例如文件被移走或磁盘暂时写满
+            bump(_errors);
+            ::close(_fd);
+            _fd = -1;
+            _unsynced = 0;
+            _sync_epoch++;
+            return;
+        }
+        size_t before = _unsynced;
+        if (before == 0) _dirty_since = std::chrono::steady_clock::now();
+        _unsynced += total;
+        if (_syncer.joinable()) {
+            // 开始计时或达到字节上限时通知后台线程
+            if (before == 0 || (before < _policy.sync_bytes &&
+                                _unsynced >= _policy.sync_bytes))
+                _cond.notify_one();
+            return;
+        }
+        if (needSync()) sync();
+    }
+
+    FdSinkStats stats() const {
+        FdSinkStats res;
+        res.writes = _writes.load(std::memory_order_relaxed);
+        res.write_bytes = _write_bytes.load(std::memory_order_relaxed);
+        res.write_ns = _write_ns.load(std::memory_order_relaxed);
+        res.write_max_ns = _write_max_ns.load(std::memory_order_relaxed);
+        res.syncs = _syncs.load(std::memory_order_relaxed);
+        res.sync_ns = _sync_ns.load(std::memory_order_relaxed);
+        res.sync_max_ns = _sync_max_ns.load(std::memory_order_relaxed);
+        res.errors = _errors.load(std::memory_order_relaxed);
+        return res;
+    }
+
+private:
+    bool openFile() {
+        _fd = ::open(_pathname.c_str(),
+                     O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (_fd < 0) {
+            std::cerr << "打开日志文件失败: " << _pathname << ": "
+                      << strerror(errno) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // 处理部分写入和EINTR，单次writev最多IOV_MAX段
+    bool writeAll(const struct iovec *iov, int iovcnt) {
+        struct iovec local[IOV_MAX];
+        while (iovcnt > 0) {
+            int n = std::min(iovcnt, (int)IOV_MAX);
+            memcpy(local, iov, n * sizeof(struct iovec));
+            struct iovec *cur = local;
+            int left = n;
+            while (left > 0) {
+                ssize_t ret = ::writev(_fd, cur, left);
+                if (ret < 0) {
+                    if (errno == EINTR) continue;
+                    return false;
+                }
+                size_t done = (size_t)ret;
+                while (left > 0 && done >= cur->iov_len) {
+                    done -= cur->iov_len;
+                    cur++;
+                    left--;
+                }
+                if (left > 0) {
+                    cur->iov_base = (char *)cur->iov_base + done;
+                    cur->iov_len -= done;
+                }
+            }
+            iov += n;
+            iovcnt -= n;
+        }
+        return true;
+    }
+
+    // INTERVAL由后台线程同步，见syncEntry
+    bool needSync() { return _policy.mode == SyncPolicy::Mode::PER_BATCH; }
+
+    // 持有_mutex时调用
+    void sync() {
+        auto start = std::chrono::steady_clock::now();
+        if (::fdatasync(_fd) < 0) bump(_errors);
+        recordLatency(_syncs, _sync_ns, _sync_max_ns, start);
+        _unsynced = 0;
+        _sync_epoch++;
+    }
+
+    // INTERVAL：最早的未同步数据到期时同步，不依赖之后是否还有写入；
+    // fdatasync在锁外进行，同步期间写入照常进行
+    void syncEntry() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (!_stop) {
+            if (_unsynced == 0 || _fd < 0) {
+                _cond.wait(lock);
+                continue;
+            }
+            auto now = std::chrono::steady_clock::now();
+            auto due = _dirty_since + _policy.sync_interval;
+            if (now < due && _unsynced < _policy.sync_bytes) {
+                _cond.wait_until(lock, due);
+                continue;
+            }
+            // dup出的描述符指向同一个打开的文件，锁外写入失败关闭_fd也不影响
+            int fd = ::dup(_fd);
+            if (fd < 0) {
+                bump(_errors);
+                _dirty_since = now;  // 下一个间隔再试
+                continue;
+            }
+            size_t synced = _unsynced;
+            uint64_t epoch = _sync_epoch;
+            lock.unlock();
+            bool ok = ::fdatasync(fd) == 0;
+            ::close(fd);
+            lock.lock();
+            if (!ok) bump(_errors);
+            recordLatency(_syncs, _sync_ns, _sync_max_ns, now);
+            // 期间没有其他同步或重新打开时，只扣除已同步的部分；
+            // 之后写入的数据从这次同步开始时计时
+            if (epoch == _sync_epoch) {
+                _unsynced -= synced;
+                _dirty_since = now;
+                _sync_epoch++;
+            }
+        }
+    }
+
+    static void bump(std::atomic<uint64_t> &counter, uint64_t n = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + n,
+                      std::memory_order_relaxed);
+    }
+
+    // 统计只在持有_mutex时写入(落地线程和后台同步线程)，
+    // 读方不加锁，因此用relaxed原子变量
+    static void recordLatency(std::atomic<uint64_t> &count,
+                              std::atomic<uint64_t> &total_ns,
+                              std::atomic<uint64_t> &max_ns,
+                              std::chrono::steady_clock::time_point start) {
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+        bump(count);
+        bump(total_ns, ns);
+        if (ns > max_ns.load(std::memory_order_relaxed))
+            max_ns.store(ns, std::memory_order_relaxed);
+    }
+
+private:
+    std::string _pathname;
+    SyncPolicy _policy;
+    std::mutex _mutex;  // 保护文件和同步状态，写入与后台同步线程之间互斥
+    int _fd;
+    size_t _unsynced;  // 上次同步之后写入的字节数
+    uint64_t _sync_epoch;  // 每次同步或重新打开时加一，后台同步据此判断扣除
+    std::chrono::steady_clock::time_point _dirty_since;  // 最早的未同步数据的写入时间
+    bool _stop;                    // 后台同步线程退出标志(受_mutex保护)
+    std::condition_variable _cond;  // 后台同步线程等待新数据或到期
+    std::thread _syncer;            // INTERVAL模式的后台同步线程
+    std::atomic<uint64_t> _writes{0};
+    std::atomic<uint64_t> _write_bytes{0};
+    std::atomic<uint64_t> _write_ns{0};
+    std::atomic<uint64_t> _write_max_ns{0};
+    std::atomic<uint64_t> _syncs{0};
+    std::atomic<uint64_t> _sync_ns{0};
+    std::atomic<uint64_t> _sync_max_ns{0};
+    std::atomic<uint64_t> _errors{0};
+};
+}  // namespace wlog
@@ -0,0 +1,315 @@
+// 结构化字段
+//   1. 调用方通过wlog::kv("key", value)给出带类型的字段，
+//      取值可以是整数、浮点、布尔、字符串或std::chrono时长
+//   2. 生产者把字段编码为紧凑的二进制形式，不做任何文本转换：
+//      类型(1字节) + 键长(1字节) + 键 + 值
+//      整数/浮点/时长保存8字节原始值，布尔保存1字节，字符串保存4字节长度 + 内容
+//   3. 格式化时由%k子项渲染为logfmt或JSON
+#pragma once
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace wlog {
+struct Field {
+    enum class Type : uint8_t { INT, UINT, DOUBLE, BOOL, STRING, DURATION };
+
+    std::string_view key;
+    Type type;
+    union {
+        int64_t i;  // INT，DURATION为纳秒数
+        uint64_t u;
+        double d;
+        bool b;
+    };
+    std::string_view str;  // STRING
+};
+
+// 构造字段，键和字符串值只是视图，需要在本次日志调用期间保持有效
+template <typename T,
+          typename std::enable_if<std::is_integral<T>::value &&
+                                      !std::is_same<T, bool>::value,
+                                  int>::type = 0>
+inline Field kv(std::string_view key, T value) {
+    Field field;
+    field.key = key;
+    if (std::is_signed<T>::value) {
+        field.type = Field::Type::INT;
+        field.i = (int64_t)value;
+    } else {
+        field.type = Field::Type::UINT;
+        field.u = (uint64_t)value;
+    }
+    return field;
+}
+template <typename T, typename std::enable_if<
+                          std::is_floating_point<T>::value, int>::type = 0>
+inline Field kv(std::string_view key, T value) {
+    Field field;
+    field.key = key;
+    field.type = Field::Type::DOUBLE;
+    field.d = (double)value;
+    return field;
+}
+inline Field kv(std::string_view key, bool value) {
+    Field field;
+    field.key = key;
+    field.type = Field::Type::BOOL;
+    field.b = value;
+    return field;
+}
+inline Field kv(std::string_view key, std::string_view value) {
+    Field field;
+    field.key = key;
+    field.type = Field::Type::STRING;
+    field.u = 0;
+    field.str = value;
+    return field;
+}
+inline Field kv(std::string_view key, const char *value) {
+    return kv(key, std::string_view(value ? value : "(null)"));
+}
+template <typename Rep, typename Period>
+inline Field kv(std::string_view key,
+                std::chrono::duration<Rep, Period> value) {
+    Field field;
+    field.key = key;
+    field.type = Field::Type::DURATION;
+    field.i = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  value)
+                  .count();
+    return field;
+}
+
+// 字段的编码与渲染
+class FieldCodec {
+public:
+    enum class Style { LOGFMT, JSON };
+
+    // 生产者：把count个字段编码后追加到out，超过255字节的键被截断
+    static void encode(std::string &out, const Field *fields, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            const Field &field = fields[i];
+            size_t key_len = field.key.size() > 255 ? 255 : field.key.size();
+            out.push_back((char)field.type);
+            out.push_back((char)(uint8_t)key_len);
+            out.append(field.key.data(), key_len);
+            switch (field.type) {
+                case Field::Type::BOOL:
+                    out.push_back(field.b ? 1 : 0);
+                    break;
+                case Field::Type::STRING: {
+                    uint32_t len = (uint32_t)field.str.size();
+                    out.append((const char *)&len, sizeof(len));
+                    out.append(field.str.data(), len);
+                    break;
+                }
+                default:
+                    // INT/UINT/DOUBLE/DURATION共用同一个8字节表示
+                    out.append((const char *)&field.u, sizeof(field.u));
+                    break;
+            }
+        }
+    }
+
+    // 从pos开始解码一个字段，键和字符串值指向编码数据；
+    // 数据不完整时返回false
+    static bool next(const char *&pos, const char *end, Field &field) {
+        if (end - pos < 2) return false;
+        uint8_t type = (uint8_t)pos[0];
+        size_t key_len = (uint8_t)pos[1];
+        if (type > (uint8_t)Field::Type::DURATION) return false;
+        if ((size_t)(end - pos) < 2 + key_len) return false;
+        field.type = (Field::Type)type;
+        field.key = std::string_view(pos + 2, key_len);
+        const char *p = pos + 2 + key_len;
+        switch (field.type) {
+            case Field::Type::BOOL:
+                if (end - p < 1) return false;
+                field.b = *p != 0;
+                p += 1;
+                break;
+            case Field::Type::STRING: {
+                uint32_t len;
+                if ((size_t)(end - p) < sizeof(len)) return false;
+                memcpy(&len, p, sizeof(len));
+                p += sizeof(len);
+                if ((size_t)(end - p) < len) return false;
+                field.str = std::string_view(p, len);
+                p += len;
+                break;
+            }
+            default:
+                if ((size_t)(end - p) < sizeof(field.u)) return false;
+                memcpy(&field.u, p, sizeof(field.u));
+                p += sizeof(field.u);
+                break;
+        }
+        pos = p;
+        return true;
+    }
+
+    // 渲染编码后的字段：
+    //   LOGFMT: key=value key2="带 空格"，没有字段时不输出
+    //   JSON:   {"key":value,"key2":"..."}，没有字段时输出{}
+    static void render(std::string &out, std::string_view data, Style style) {
+        const char *pos = data.data();
+        const char *end = pos + data.size();
+        Field field;
+        bool first = true;
+        if (style == Style::JSON) out.push_back('{');
+        while (next(pos, end, field)) {
+            if (style == Style::JSON) {
+                if (!first) out.push_back(',');
+                appendJsonString(out, field.key);
+                out.push_back(':');
+                appendJsonValue(out, field);
+            } else {
+                if (!first) out.push_back(' ');
+                appendLogfmtString(out, field.key);
+                out.push_back('=');
+                appendLogfmtValue(out, field);
+            }
+            first = false;
+        }
+        if (style == Style::JSON) out.push_back('}');
+    }
+
+private:
+    template <typename T>
+    static void appendNumber(std::string &out, T value) {
+        char tmp[32];
+        auto res = std::to_chars(tmp, tmp + sizeof(tmp), value);
+        out.append(tmp, res.ptr - tmp);
+    }
+
+    // 以能整除的最大单位输出时长，例如1500us、2s
+    static void appendDuration(std::string &out, int64_t ns) {
+        static const struct {
+            int64_t scale;
+            const char *unit;
+        } units[] = {{1000000000, "s"}, {1000000, "ms"}, {1000, "us"}};
+        for (auto &u : units) {
+            if (ns != 0 && ns % u.scale == 0) {
+                appendNumber(out, ns / u.scale);
+                out.append(u.unit);
+                return;
+            }
+        }
+        appendNumber(out, ns);
+        out.append("ns");
+    }
+
+    static void appendLogfmtValue(std::string &out, const Field &field) {
+        switch (field.type) {
+            case Field::Type::INT:
+                appendNumber(out, field.i);
+                break;
+            case Field::Type::UINT:
+                appendNumber(out, field.u);
+                break;
+            case Field::Type::DOUBLE:
+                appendNumber(out, field.d);
+                break;
+            case Field::Type::BOOL:
+                out.append(field.b ? "true" : "false");
+                break;
+            case Field::Type::STRING:
+                appendLogfmtString(out, field.str);
+                break;
+            case Field::Type::DURATION:
+                appendDuration(out, field.i);
+                break;
+        }
+    }
+
+    // JSON没有时长类型，按纳秒整数输出；NaN和无穷输出null
+    static void appendJsonValue(std::string &out, const Field &field) {
+        switch (field.type) {
+            case Field::Type::INT:
+            case Field::Type::DURATION:
+                appendNumber(out, field.i);
+                break;
+            case Field::Type::UINT:
+                appendNumber(out, field.u);
+                break;
+            case Field::Type::DOUBLE:
+                if (std::isfinite(field.d))
+                    appendNumber(out, field.d);
+                else
+                    out.append("null");
+                break;
+            case Field::Type::BOOL:
+                out.append(field.b ? "true" : "false");
+                break;
+            case Field::Type::STRING:
+                appendJsonString(out, field.str);
+                break;
+        }
+    }
+
+    // 空串或包含空白、'='、'"'、控制字符时加引号
+    static void appendLogfmtString(std::string &out, std::string_view str) {
+        bool quote = str.empty();
+        for (unsigned char c : str) {
+            if (c <= ' ' || c == '=' || c == '"' || c == 0x7f) {
+                quote = true;
+                break;
+            }
+        }
+        if (!quote) {
+            out.append(str);
+            return;
+        }
+        appendEscaped(out, str, false);
+    }
+    static void appendJsonString(std::string &out, std::string_view str) {
+        appendEscaped(out, str, true);
+    }
+
+    static void appendEscaped(std::string &out, std::string_view str,
+                              bool json) {
+        static const char hex[] = "0123456789abcdef";
+        out.push_back('"');
+        size_t begin = 0;
+        for (size_t i = 0; i < str.size(); i++) {
+            unsigned char c = str[i];
+            if (c >= 0x20 && c != '"' && c != '\\' && c != 0x7f) continue;
+            out.append(str.data() + begin, i - begin);
+            begin = i + 1;
+            out.push_back('\\');
+            switch (c) {
+                case '"':
+                case '\\':
+                    out.push_back(c);
+                    break;
+                case '\n':
+                    out.push_back('n');
+                    break;
+                case '\r':
+                    out.push_back('r');
+                    break;
+                case '\t':
+                    out.push_back('t');
+                    break;
+                default:
+                    if (json) {
+                        out.append("u00");
+                    } else {
+                        out.push_back('x');
+                    }
+                    out.push_back(hex[c >> 4]);
+                    out.push_back(hex[c & 0xf]);
+                    break;
+            }
+        }
+        out.append(str.data() + begin, str.size() - begin);
+        out.push_back('"');
+    }
+};
+}  // namespace wlog
@@ -8,111 +8,180 @@
 #include <sstream>
 #include <vector>
 
+#include "fields.hpp"
 #include "level.hpp"
 #include "message.hpp"
+#include "static_format.hpp"
 
 namespace wlog {
 // 格式化子项的基类
+// 子项直接追加到输出字符串，不经过ostream
 class FormatItem {
 public:
     using ptr = std::shared_ptr<FormatItem>;
-    virtual void format(std::ostream &out, const LogMsg &msg) = 0;
+    virtual ~FormatItem() {}
+    virtual void format(std::string &out, const LogMsg &msg) = 0;
 };
 // 有效载荷-日志等级-日志器名称-线程ID-时间-文件名-行号-制表符-换行-其他
 class MsgFormatItem : public FormatItem {
 public:
-    void format(std::ostream &out, const LogMsg &msg) override {
-        out << msg._payload;
+    // 格式中没有%k时由%m在消息之后以logfmt形式输出字段，避免字段丢失
+    MsgFormatItem(bool with_fields = false) : _with_fields(with_fields) {}
+    void format(std::string &out, const LogMsg &msg) override {
+        out.append(msg._payload);
+        if (_with_fields && !msg._fields.empty()) {
+            if (!msg._payload.empty()) out.push_back(' ');
+            FieldCodec::render(out, msg._fields, FieldCodec::Style::LOGFMT);
+        }
     }
+
+private:
+    bool _with_fields;
+};
+class FieldsFormatItem : public FormatItem {
+public:
+    FieldsFormatItem(FieldCodec::Style style) : _style(style) {}
+    void format(std::string &out, const LogMsg &msg) override {
+        FieldCodec::render(out, msg._fields, _style);
+    }
+
+private:
+    FieldCodec::Style _style;
 };
 class LevelFormatItem : public FormatItem {
 public:
-    void format(std::ostream &out, const LogMsg &msg) override {
-        out << LogLevel::toString(msg._level);
+    void format(std::string &out, const LogMsg &msg) override {
+        out.append(LogLevel::toCString(msg._level));
     }
 };
 class LoggerFormatItem : public FormatItem {
 public:
-    void format(std::ostream &out, const LogMsg &msg) override {
-        out << msg._logger;
+    void format(std::string &out, const LogMsg &msg) override {
+        out.append(msg._logger);
     }
 };
 class ThreadIdFormatItem : public FormatItem {
 public:
-    void format(std::ostream &out, const LogMsg &msg) override {
-        out << msg._tid;
+    // kernel为true时输出内核线程ID(%t{tid})，与top、perf一致
+    ThreadIdFormatItem(bool kernel = false) : _kernel(kernel) {}
+    void format(std::string &out, const LogMsg &msg) override {
+        if (_kernel)
+            ThreadInfo::appendTid(out, msg._ktid);
+        else
+            appendThreadId(out, msg._tid);
+    }
+
+private:
+    bool _kernel;
+};
+class ThreadNameFormatItem : public FormatItem {
+public:
+    void format(std::string &out, const LogMsg &msg) override {
+        ThreadInfo::appendName(out, msg._ktid);
     }
 };
 class TimeFormatItem : public FormatItem {
 public:
-    TimeFormatItem(const std::string &fmt = "%H:%M:%S") : _time_fmt(fmt) {}
-    void format(std::ostream &out, const LogMsg &msg) override {
-        struct tm t;
-        localtime_r(&msg._c_time, &t);
-        char tmp[32];
-        memset(tmp, 0, sizeof(tmp));
-        strftime(tmp, 31, _time_fmt.c_str(), &t);
-        out << tmp;
+    TimeFormatItem(const std::string &fmt = "%H:%M:%S") : _renderer(fmt) {}
+    void format(std::string &out, const LogMsg &msg) override {
+        _renderer.format(out, msg._c_time, msg._nsec);
     }
 
 private:
-    std::string _time_fmt;
+    TimeRenderer _renderer;
 };
 class FileFormatItem : public FormatItem {
 public:
-    void format(std::ostream &out, const LogMsg &msg) override {
-        out << msg._file;
+    void format(std::string &out, const LogMsg &msg) override {
+        out.append(msg._file);
     }
 };
 class LineFormatItem : public FormatItem {
 public:
-    void format(std::ostream &out, const LogMsg &msg) override {
-        out << msg._line;
+    void format(std::string &out, const LogMsg &msg) override {
+        appendInteger(out, msg._line);
     }
 };
 class TableFormatItem : public FormatItem {
 public:
-    void format(std::ostream &out, const LogMsg &msg) override { out << "\t"; }
+    void format(std::string &out, const LogMsg &msg) override {
+        out.push_back('\t');
+    }
 };
 class NlineFormatItem : public FormatItem {
 public:
-    void format(std::ostream &out, const LogMsg &msg) override { out << "\n"; }
+    void format(std::string &out, const LogMsg &msg) override {
+        out.push_back('\n');
+    }
 };
 class OtherFormatItem : public FormatItem {
 public:
     OtherFormatItem(const std::string str) : _str(str) {}
-    void format(std::ostream &out, const LogMsg &msg) override { out << _str; }
+    void format(std::string &out, const LogMsg &msg) override {
+        out.append(_str);
+    }
 
 private:
     std::string _str;
 };
-// %d 日期，包含子项时分秒{%H:%M:%S}
-// %t 线程ID
+// %d 日期，包含子项时分秒{%H:%M:%S}，可用%ms/%us/%ns输出秒内小数
+// %t 线程ID，%t{tid}为内核线程ID
+// %N 线程名称(wlog::setThreadName)，没有设置时为内核线程ID
 // %c 日志器名称
 // %p 日志等级
 // %f 所在文件名
 // %l 所在行号
 // %T 表示制表符
 // %m 表示消息主体
+// %k 结构化字段，{logfmt}(默认)或{json}
 // %n 表示换行
 class Formatter {
 public:
     using ptr = std::shared_ptr<Formatter>;
-    Formatter(
-        const std::string &pattern = "[%d{%H:%M:%S}][%t][%c][%p][%f:%l]%T%m%n")
-        : _pattern(pattern) {
-        assert(parsePattern());
+    // 编译期格式化器的入口
+    using StaticFunc = void (*)(std::string &, const LogMsg &);
+
+    Formatter(const std::string &pattern = DEFAULT_PATTERN)
+        : _pattern(pattern), _has_fields(false), _static_func(nullptr) {
+        // 默认格式直接使用编译期展开的版本
+        if (_pattern == DEFAULT_PATTERN)
+            _static_func = &StaticFormatter<DEFAULT_PATTERN>::format;
+        // 解析失败时终止，与未知格式字符的处理一致
+        if (!parsePattern()) {
+            std::cout << "格式化字符串错误：" << _pattern << std::endl;
+            abort();
+        }
     }
-    // 对msg格式化
-    void format(std::ostream &out, LogMsg &msg) {
+
+    // 使用编译期解析的格式化字符串构造
+    template <const char *Pattern>
+    static Formatter::ptr createStatic() {
+        auto formatter = std::make_shared<Formatter>(Pattern);
+        formatter->_static_func = &StaticFormatter<Pattern>::format;
+        return formatter;
+    }
+
+    const std::string &pattern() const { return _pattern; }
+
+    // 对msg格式化，追加到out之后
+    void format(std::string &out, const LogMsg &msg) {
+        if (_static_func) {
+            _static_func(out, msg);
+            return;
+        }
         for (auto &item : _items) {
             item->format(out, msg);
         }
     }
-    std::string format(LogMsg &msg) {
-        std::stringstream ss;
-        format(ss, msg);
-        return ss.str();
+    void format(std::ostream &out, const LogMsg &msg) {
+        std::string str;
+        format(str, msg);
+        out.write(str.data(), str.size());
+    }
+    std::string format(const LogMsg &msg) {
+        std::string str;
+        format(str, msg);
+        return str;
     }
 
 private:
@@ -165,6 +234,10 @@ private:
             val.clear();
         }
         // 根据得到的数据初始化不同的子项
+        _has_fields = false;
+        for (auto &it : format_order) {
+            if (it.first == "k") _has_fields = true;
+        }
         for (auto &it : format_order) {
             _items.emplace_back(createItem(it.first, it.second));
         }
@@ -175,22 +248,40 @@ private:
     // 根据不同的格式创建不同的子项
     FormatItem::ptr createItem(const std::string &key, const std::string &val) {
         // %d 日期，包含子项时分秒{%H:%M:%S}
-        // %t 线程ID
+        // %t 线程ID，{tid}为内核线程ID
+        // %N 线程名称
         // %c 日志器名称
         // %p 日志等级
         // %f 所在文件名
         // %l 所在行号
         // %T 表示制表符
         // %m 表示消息主体
+        // %k 结构化字段
         // %n 表示换行
         if (key == "d") return std::make_shared<TimeFormatItem>(val);
-        if (key == "t") return std::make_shared<ThreadIdFormatItem>();
+        if (key == "t") {
+            if (val.empty()) return std::make_shared<ThreadIdFormatItem>();
+            if (val == "tid") return std::make_shared<ThreadIdFormatItem>(true);
+            std::cout << "没有对应的线程ID格式：" << val << std::endl;
+            abort();
+        }
+        if (key == "N") return std::make_shared<ThreadNameFormatItem>();
         if (key == "c") return std::make_shared<LoggerFormatItem>();
         if (key == "p") return std::make_shared<LevelFormatItem>();
         if (key == "f") return std::make_shared<FileFormatItem>();
         if (key == "l") return std::make_shared<LineFormatItem>();
         if (key == "T") return std::make_shared<TableFormatItem>();
-        if (key == "m") return std::make_shared<MsgFormatItem>();
+        if (key == "m") return std::make_shared<MsgFormatItem>(!_has_fields);
+        if (key == "k") {
+            if (val.empty() || val == "logfmt")
+                return std::make_shared<FieldsFormatItem>(
+                    FieldCodec::Style::LOGFMT);
+            if (val == "json")
+                return std::make_shared<FieldsFormatItem>(
+                    FieldCodec::Style::JSON);
+            std::cout << "没有对应的字段格式：" << val << std::endl;
+            abort();
+        }
         if (key == "n") return std::make_shared<NlineFormatItem>();
         if (key.empty()) return std::make_shared<OtherFormatItem>(val);
         std::cout << "没有对应的格式化字符：%" << key << std::endl;
@@ -201,5 +292,7 @@ private:
 private:
     std::string _pattern;
     std::vector<FormatItem::ptr> _items;
+    bool _has_fields;         // 格式中是否含有%k
+    StaticFunc _static_func;  // 非空时跳过_items，走编译期展开的版本
 };
 }  // namespace wlog
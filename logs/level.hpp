@@ -9,7 +9,10 @@ class LogLevel {
 public:
     enum class Value { DEBUG = 0, INFO, WARNING, ERROR, FATAL, OFF };
 
-    static const std::string toString(Value value) {
+    static const std::string toString(Value value) { return toCString(value); }
+
+    // 返回静态字符串，格式化时无需构造std::string
+    static const char *toCString(Value value) {
         switch (value) {
             case Value::DEBUG:
                 return "DEBUG";
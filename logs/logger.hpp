@@ -2,150 +2,400 @@
 //   1. 抽象出日志器基类
 //   2. 实现子类（同步 & 异步）
 //   3. 引入建造者类
+//   4. 落地方向可以有自己的等级和格式(见sink.hpp)：每种格式只格式化一次，
+//      只有至少一个落地方向接收该等级时才格式化；没有落地方向接收的日志
+//      在解析参数之前就被丢弃
+#pragma once
+#include <algorithm>
 #include <atomic>
 #include <cstdarg>
+#include <cstring>
+#include <initializer_list>
 #include <mutex>
 #include <unordered_map>
 
+#include "brace_format.hpp"
+#include "callsite.hpp"
+#include "compresssink.hpp"
 #include "format.hpp"
+#include "deferred.hpp"
+#include "fdsink.hpp"
+#include "fields.hpp"
 #include "level.hpp"
 #include "looper.hpp"
 #include "message.hpp"
+#include "metrics.hpp"
+#include "mmapsink.hpp"
+#include "pipeline.hpp"
+#include "ratelimit.hpp"
+#include "ringlooper.hpp"
 #include "sink.hpp"
+#include "sinkqueue.hpp"
 #include "util.hpp"
 
 namespace wlog {
+#define PAYLOAD_STACK_SIZE 1024  // 有效消息的栈缓冲区大小
+#define DEFAULT_BACKEND_THREADS 2  // 共享线程池的默认线程数
+#define DEFAULT_METRICS_SAMPLE 16  // 逐条统计项的默认采样间隔
+
 class Logger {
 public:
     using ptr = std::shared_ptr<Logger>;
+    // metrics非空时记录格式化和落地的统计，见metrics()
     Logger(const std::string &logger_name, LogLevel::Value &limit_level,
-           const Formatter::ptr &fommatter, std::vector<LogSink::ptr> sinks)
+           const Formatter::ptr &fommatter, std::vector<LogSink::ptr> sinks,
+           const PipelineMetrics::ptr &metrics = nullptr)
         : _logger_name(logger_name),
           _limit_level(limit_level),
           _formatter(fommatter),
-          _sinks(sinks.begin(), sinks.end()) {}
+          _sinks(sinks.begin(), sinks.end()),
+          _metrics(metrics),
+          _has_queued(false),
+          _routed(false) {
+        // 带独立队列的落地方向由自己的写线程记录统计
+        for (size_t i = 0; i < _sinks.size(); i++) {
+            QueuedSink *queued = dynamic_cast<QueuedSink *>(_sinks[i].get());
+            _queued.push_back(queued);
+            if (!queued) continue;
+            _has_queued = true;
+            if (_metrics) queued->attachMetrics(_metrics->sink(i));
+        }
+        buildRoutes(limit_level);
+    }
+    virtual ~Logger() {
+        // 落地队列可能被其他日志器共用，写空之后解除与本日志器统计的关联
+        for (QueuedSink *queued : _queued) {
+            if (!queued) continue;
+            queued->flush();
+            if (_metrics) queued->attachMetrics(nullptr);
+        }
+    }
 
     const std::string &getName() { return _logger_name; }
 
+    // 统计快照：未开启统计时只有丢弃条数和缓冲区数量有效；
+    // 只读取原子计数，可以在任意线程中频繁调用
+    virtual MetricsSnapshot metrics() const {
+        MetricsSnapshot res;
+        if (_metrics) _metrics->snapshot(res);
+        res.sinks.resize(_sinks.size());
+        for (size_t i = 0; i < _queued.size(); i++) {
+            if (!_queued[i]) continue;
+            res.sinks[i].dropped_batches = _queued[i]->droppedBatches();
+            res.sinks[i].dropped_bytes = _queued[i]->droppedBytes();
+            res.sinks[i].pending_batches = _queued[i]->pendingBatches();
+        }
+        return res;
+    }
+
     // 构造消息，格式化，输出
     // 分为五种
-    void debug(const std::string file, const size_t line, const std::string fmt,
-               ...) {
+    // file通常为__FILE__，fmt为printf风格的格式字符串
+    void debug(const char *file, size_t line, const char *fmt, ...) {
         // 1.检查限制等级
-        if (LogLevel::Value::DEBUG < _limit_level) {
-            return;
-        }
-        // 2.根据fmt和不定参组织字符串
+        if (!shouldLog(LogLevel::Value::DEBUG)) return;
+        // 2.根据fmt和不定参组织字符串，序列化并输出
         va_list ap;
         va_start(ap, fmt);
-        char *res;
-        int ret = vasprintf(&res, fmt.c_str(), ap);
-        if (ret == -1) {
-            std::cerr << "vasprintf出错了" << std::endl;
-            return;
-        }
+        logv(LogLevel::Value::DEBUG, file, line, fmt, ap);
         va_end(ap);
-        // 序列化并输出
-        serialize(LogLevel::Value::DEBUG, file, line, res);
-        // 注意需要释放这里的res
-        free(res);
     }
-    void info(const std::string file, size_t line, const std::string fmt, ...) {
-        // 1.检查限制等级
-        if (LogLevel::Value::INFO < _limit_level) {
-            return;
-        }
-        // 2.根据fmt和不定参组织字符串
+    void info(const char *file, size_t line, const char *fmt, ...) {
+        if (!shouldLog(LogLevel::Value::INFO)) return;
         va_list ap;
         va_start(ap, fmt);
-        char *res;
-        int ret = vasprintf(&res, fmt.c_str(), ap);
-        if (ret == -1) {
-            std::cerr << "vasprintf出错了" << std::endl;
-            return;
-        }
+        logv(LogLevel::Value::INFO, file, line, fmt, ap);
         va_end(ap);
-        // 序列化并输出
-        serialize(LogLevel::Value::INFO, file, line, res);
-        // 注意需要释放这里的res
-        free(res);
     }
-    void warning(const std::string file, size_t line, const std::string fmt,
-                 ...) {
-        // 1.检查限制等级
-        if (LogLevel::Value::WARNING < _limit_level) {
-            return;
-        }
-        // 2.根据fmt和不定参组织字符串
+    void warning(const char *file, size_t line, const char *fmt, ...) {
+        if (!shouldLog(LogLevel::Value::WARNING)) return;
         va_list ap;
         va_start(ap, fmt);
-        char *res;
-        int ret = vasprintf(&res, fmt.c_str(), ap);
-        if (ret == -1) {
-            std::cerr << "vasprintf出错了" << std::endl;
-            return;
-        }
+        logv(LogLevel::Value::WARNING, file, line, fmt, ap);
         va_end(ap);
-        // 序列化并输出
-        serialize(LogLevel::Value::WARNING, file, line, res);
-        // 注意需要释放这里的res
-        free(res);
     }
-    void error(const std::string file, size_t line, const std::string fmt,
-               ...) {
-        // 1.检查限制等级
-        if (LogLevel::Value::ERROR < _limit_level) {
-            return;
-        }
-        // 2.根据fmt和不定参组织字符串
+    void error(const char *file, size_t line, const char *fmt, ...) {
+        if (!shouldLog(LogLevel::Value::ERROR)) return;
         va_list ap;
         va_start(ap, fmt);
-        char *res;
-        int ret = vasprintf(&res, fmt.c_str(), ap);
-        if (ret == -1) {
-            std::cerr << "vasprintf出错了" << std::endl;
-            return;
-        }
+        logv(LogLevel::Value::ERROR, file, line, fmt, ap);
         va_end(ap);
-        // 序列化并输出
-        serialize(LogLevel::Value::ERROR, file, line, res);
-        // 注意需要释放这里的res
-        free(res);
     }
-    void fatal(const std::string file, size_t line, const std::string fmt,
-               ...) {
-        // 1.检查限制等级
-        if (LogLevel::Value::FATAL < _limit_level) {
-            return;
-        }
-        // 2.根据fmt和不定参组织字符串
+    void fatal(const char *file, size_t line, const char *fmt, ...) {
+        if (!shouldLog(LogLevel::Value::FATAL)) return;
         va_list ap;
         va_start(ap, fmt);
-        char *res;
-        int ret = vasprintf(&res, fmt.c_str(), ap);
-        if (ret == -1) {
-            std::cerr << "vasprintf出错了" << std::endl;
-            return;
+        logv(LogLevel::Value::FATAL, file, line, fmt, ap);
+        va_end(ap);
+    }
+
+    // 以下接口不检查等级限制，由调用方先检查；WLOG_xxx宏在调用点检查，
+    // 被强制打开的调用点(见callsite.hpp)可以越过日志器的等级限制
+
+    // printf风格，与debug/info/...相同
+    void logAt(LogLevel::Value level, const char *file, size_t line,
+               const char *fmt, ...) {
+        va_list ap;
+        va_start(ap, fmt);
+        logv(level, file, line, fmt, ap);
+        va_end(ap);
+    }
+
+    // 结构化日志：msg原样作为有效消息，不经过printf解析；字段以二进制形式
+    // 随消息传递，由格式化子项%k渲染(格式中没有%k时跟在%m之后)，例如：
+    //   logger->logKv(wlog::LogLevel::Value::INFO, __FILE__, __LINE__,
+    //                 "login", {wlog::kv("uid", uid), wlog::kv("cost", cost)});
+    void logKv(LogLevel::Value level, const char *file, size_t line,
+               std::string_view msg, std::initializer_list<Field> fields) {
+        logFields(level, file, line, msg, fields.begin(), fields.size());
+    }
+
+    // 限流宏使用：suppressed为0时与普通调用相同；否则在生产者侧格式化，
+    // 并附加suppressed字段报告之前被抑制的条数
+    void logSuppressed(LogLevel::Value level, const char *file, size_t line,
+                       uint64_t suppressed, const char *fmt, ...) {
+        if (!sinkAccepts(level)) return;
+        va_list ap;
+        va_start(ap, fmt);
+        if (suppressed == 0) {
+            logv(level, file, line, fmt, ap);
+        } else {
+            std::string &payload = scratch().payload;
+            va_list cp;
+            va_copy(cp, ap);
+            int ret = vsnprintf(nullptr, 0, fmt, cp);
+            va_end(cp);
+            payload.resize(ret > 0 ? ret + 1 : 1);
+            vsnprintf(&payload[0], payload.size(), fmt, ap);
+            payload.resize(ret > 0 ? ret : 0);
+            Field field = kv("suppressed", suppressed);
+            logFields(level, file, line, payload, &field, 1);
+            if (payload.capacity() > kScratchKeepSize)
+                std::string().swap(payload);
         }
         va_end(ap);
-        // 序列化并输出
-        serialize(LogLevel::Value::FATAL, file, line, res);
-        // 注意需要释放这里的res
-        free(res);
+    }
+
+    // 花括号格式的类型安全接口，数值用std::to_chars转换，不经过vsnprintf；
+    // 格式串的编译期检查由WLOG_xxx_FMT宏完成，例如：
+    //   WLOG_INFO_FMT(logger, "user={} latency={}us", id, us);
+    template <typename... Args>
+    void logFmt(LogLevel::Value level, const char *file, size_t line,
+                const char *fmt, const Args &...args) {
+        if (!sinkAccepts(level)) return;
+        std::string &payload = scratch().payload;
+        payload.clear();
+        BraceFormat::format(payload, fmt, args...);
+        // 与结构化日志共用同一路径，延迟格式化时消息原样写入记录
+        logFields(level, file, line, payload, nullptr, 0);
+        if (payload.capacity() > kScratchKeepSize) std::string().swap(payload);
+    }
+
+    // 等级检查，只做一次relaxed读取；
+    // 限制等级已经提高到所有落地方向中最低的等级
+    bool shouldLog(LogLevel::Value level) const {
+        return level >= _limit_level.load(std::memory_order_relaxed);
     }
 
 protected:
-    void serialize(const LogLevel::Value level, const std::string file,
-                   const size_t line, char *str) {
+    // 每个线程复用的临时缓冲区，预热后不再申请内存
+    struct Scratch {
+        std::string payload;  // 超出栈缓冲区的有效消息
+        std::string out;      // 格式化后的整条日志
+        std::string fields;   // 编码后的结构化字段
+    };
+    static Scratch &scratch() {
+        static thread_local Scratch s;
+        return s;
+    }
+    // 超过该大小的临时缓冲区用完即释放，避免一次突发长期占用内存
+    static constexpr size_t kScratchKeepSize = 1024 * 1024;
+
+    // 至少有一个落地方向接收该等级；被强制打开的调用点越过了shouldLog，
+    // 在这里按落地方向的等级再过滤一次
+    bool sinkAccepts(LogLevel::Value level) const {
+        return _level_masks[(size_t)level] != 0;
+    }
+
+    virtual void logv(LogLevel::Value level, const char *file, size_t line,
+                      const char *fmt, va_list ap) {
+        if (!sinkAccepts(level)) return;
+        // 先格式化到栈上的缓冲区，放不下时才使用线程局部的堆缓冲区
+        char stack_buf[PAYLOAD_STACK_SIZE];
+        va_list cp;
+        va_copy(cp, ap);
+        int ret = vsnprintf(stack_buf, sizeof(stack_buf), fmt, cp);
+        va_end(cp);
+        if (ret < 0) {
+            std::cerr << "vsnprintf出错了" << std::endl;
+            return;
+        }
+        if ((size_t)ret < sizeof(stack_buf)) {
+            serialize(level, file, line, std::string_view(stack_buf, ret));
+            return;
+        }
+        std::string &payload = scratch().payload;
+        payload.resize(ret + 1);
+        vsnprintf(&payload[0], payload.size(), fmt, ap);
+        serialize(level, file, line, std::string_view(payload.data(), ret));
+        if (payload.capacity() > kScratchKeepSize) std::string().swap(payload);
+    }
+
+    virtual void logFields(LogLevel::Value level, const char *file,
+                           size_t line, std::string_view msg,
+                           const Field *fields, size_t count) {
+        if (!sinkAccepts(level)) return;
+        std::string &encoded = scratch().fields;
+        encoded.clear();
+        FieldCodec::encode(encoded, fields, count);
+        serialize(level, file, line, msg, encoded);
+        if (encoded.capacity() > kScratchKeepSize) std::string().swap(encoded);
+    }
+
+    void serialize(const LogLevel::Value level, const char *file,
+                   const size_t line, std::string_view payload,
+                   std::string_view fields = std::string_view()) {
         // 3.构建msg对象，再组织成字符串
-        LogMsg msg(level, _logger_name, file, line, str);
-        std::stringstream ss;
-        _formatter->format(ss, msg);
+        LogMsg msg(level, _logger_name, file, line, payload);
+        msg._fields = fields;
+        std::string &out = scratch().out;
+        out.clear();
+        if (_routed) {
+            formatRouted(out, msg);
+        } else {
+            ScopedLatency timer(
+                sampleOf<&PipelineMetrics::format_ns>(_metrics.get()));
+            _formatter->format(out, msg);
+        }
         // 4.调用接口进行输出
-        log(ss.str().c_str(), ss.str().size());
+        log(out.data(), out.size(), level);
+        if (out.capacity() > kScratchKeepSize) std::string().swap(out);
     }
     // 将实际的输出操作设为抽象接口，具体输出方式（同步或异步）子类实现
-    virtual void log(const char *data, size_t len = 0) = 0;
+    virtual void log(const char *data, size_t len, LogLevel::Value level) = 0;
+
+    // 落地方向的等级或格式不一致时，格式化结果以帧的形式传递：
+    //   长度(4字节) + 接收该帧的落地方向掩码(8字节) + 文本
+    // 每种格式对应一个路由，同一格式的落地方向共用一份格式化结果
+    struct Route {
+        Formatter::ptr formatter;
+        uint64_t mask;  // 使用该格式的落地方向
+    };
+    static constexpr size_t kFrameHeader = sizeof(uint32_t) + sizeof(uint64_t);
+    static constexpr size_t kMaxRoutedSinks = 64;
+
+    // 按落地方向的等级和格式建立路由，并把限制等级提高到落地方向的最低等级
+    void buildRoutes(LogLevel::Value limit_level) {
+        for (auto &mask : _level_masks) mask = 0;
+        bool mixed_levels = false;
+        for (size_t i = 0; i < _sinks.size(); i++) {
+            LogLevel::Value sink_level = _sinks[i]->level();
+            if (sink_level != _sinks[0]->level()) mixed_levels = true;
+            for (size_t l = (size_t)sink_level; l < kLevelCount; l++)
+                _level_masks[l] |= i < kMaxRoutedSinks ? 1ULL << i : 0;
+            // 相同格式串的格式化器视为同一种格式
+            const Formatter::ptr &own = _sinks[i]->formatter();
+            const Formatter::ptr &formatter = own ? own : _formatter;
+            size_t r = 0;
+            while (r < _routes.size() &&
+                   _routes[r].formatter->pattern() != formatter->pattern())
+                r++;
+            if (r == _routes.size()) _routes.push_back({formatter, 0});
+            if (i < kMaxRoutedSinks) _routes[r].mask |= 1ULL << i;
+        }
+        _routed = mixed_levels || _routes.size() > 1;
+        // 掩码只有64位，超出的落地方向收不到任何帧；与格式串错误一样在创建时终止
+        if (_routed && _sinks.size() > kMaxRoutedSinks) {
+            std::cerr << "日志器" << _logger_name
+                      << "的落地方向有不同的等级或格式时最多支持"
+                      << kMaxRoutedSinks << "个，当前为" << _sinks.size()
+                      << std::endl;
+            abort();
+        }
+        // 所有落地方向使用同一种格式时直接用它格式化，不需要分帧
+        if (!_routed && !_routes.empty()) _formatter = _routes[0].formatter;
+        // 所有落地方向都不接收的等级在调用点就被过滤
+        size_t floor = 0;
+        while (floor < kLevelCount && _level_masks[floor] == 0) floor++;
+        if (!_sinks.empty() && floor > (size_t)limit_level)
+            _limit_level.store((LogLevel::Value)floor);
+    }
+
+    // 按路由格式化msg，每个接收该等级的格式追加一帧到out
+    void formatRouted(std::string &out, const LogMsg &msg) {
+        uint64_t accepted = _level_masks[(size_t)msg._level];
+        for (auto &route : _routes) {
+            uint64_t mask = route.mask & accepted;
+            if (mask == 0) continue;
+            size_t pos = out.size();
+            out.append(kFrameHeader, '\0');
+            {
+                ScopedLatency timer(
+                    sampleOf<&PipelineMetrics::format_ns>(_metrics.get()));
+                route.formatter->format(out, msg);
+            }
+            uint32_t len = (uint32_t)(out.size() - pos - kFrameHeader);
+            memcpy(&out[pos], &len, sizeof(len));
+            memcpy(&out[pos + sizeof(len)], &mask, sizeof(mask));
+        }
+    }
+
+    // 拆分帧，按掩码把文本拼接到各落地方向的输出中再写出(调用方持有_mutex)；
+    // 帧不会跨越iovec的区域
+    void writeRouted(const struct iovec *iov, int iovcnt) {
+        _sink_out.resize(_sinks.size());
+        for (int r = 0; r < iovcnt; r++) {
+            const char *pos = (const char *)iov[r].iov_base;
+            const char *end = pos + iov[r].iov_len;
+            while ((size_t)(end - pos) >= kFrameHeader) {
+                uint32_t len;
+                uint64_t mask;
+                memcpy(&len, pos, sizeof(len));
+                memcpy(&mask, pos + sizeof(len), sizeof(mask));
+                const char *text = pos + kFrameHeader;
+                if ((size_t)(end - text) < len) break;
+                for (; mask != 0; mask &= mask - 1)
+                    _sink_out[__builtin_ctzll(mask)].append(text, len);
+                pos = text + len;
+            }
+        }
+        for (size_t i = 0; i < _sinks.size(); i++) {
+            std::string &out = _sink_out[i];
+            if (out.empty()) continue;
+            if (_queued[i]) {
+                // 该落地方向独有的输出交换进批次，不再拷贝
+                SinkBatch::ptr batch = _batches.acquire();
+                batch->text.swap(out);
+                batch->fromText();
+                _queued[i]->push(batch);
+            } else {
+                sinkLog(i, out.data(), out.size());
+            }
+            out.clear();
+            if (out.capacity() > kScratchKeepSize) std::string().swap(out);
+        }
+    }
+
+    // 写入第index个落地方向，开启统计时记录耗时和字节数(调用方持有_mutex)
+    PipelineMetrics::Sink *sinkStat(size_t index) {
+        if (!_metrics || _queued[index]) return nullptr;
+        return _metrics->sink(index);
+    }
+    void sinkLog(size_t index, const char *data, size_t len) {
+        PipelineMetrics::Sink *stat = sinkStat(index);
+        ScopedLatency timer(stat ? &stat->write_ns : nullptr);
+        _sinks[index]->log(data, len);
+        if (stat) stat->bytes.fetch_add(len, std::memory_order_relaxed);
+    }
+    void sinkLogv(size_t index, const struct iovec *iov, int iovcnt) {
+        PipelineMetrics::Sink *stat = sinkStat(index);
+        ScopedLatency timer(stat ? &stat->write_ns : nullptr);
+        _sinks[index]->logv(iov, iovcnt);
+        if (!stat) return;
+        size_t len = 0;
+        for (int i = 0; i < iovcnt; i++) len += iov[i].iov_len;
+        stat->bytes.fetch_add(len, std::memory_order_relaxed);
+    }
 
 protected:
     std::mutex _mutex;
@@ -153,66 +403,381 @@ protected:
     std::atomic<LogLevel::Value> _limit_level;  // 日志输出限制等级
     Formatter::ptr _formatter;                  // 格式化
     std::vector<LogSink::ptr> _sinks;           // 日志落地位置（可以多选）
+    PipelineMetrics::ptr _metrics;              // 统计，为空时不记录
+    std::vector<QueuedSink *> _queued;  // 与_sinks对应，不带独立队列时为空
+    bool _has_queued;                   // 是否有带独立队列的落地方向
+    SinkBatchPool _batches;             // 交给落地队列的批次
+    // 落地方向各自的等级和格式
+    static constexpr size_t kLevelCount = (size_t)LogLevel::Value::OFF + 1;
+    uint64_t _level_masks[kLevelCount];  // 每个等级由哪些落地方向接收
+    std::vector<Route> _routes;          // 每种格式一个路由
+    bool _routed;  // 落地方向的等级或格式不一致，格式化结果按帧传递
+    std::vector<std::string> _sink_out;  // writeRouted使用(受_mutex保护)
 };
 
 class SyncLogger : public Logger {
 public:
     SyncLogger(const std::string &logger_name, LogLevel::Value &limit_level,
-               const Formatter::ptr &fommatter, std::vector<LogSink::ptr> sinks)
-        : Logger(logger_name, limit_level, fommatter, sinks) {}
+               const Formatter::ptr &fommatter, std::vector<LogSink::ptr> sinks,
+               const PipelineMetrics::ptr &metrics = nullptr)
+        : Logger(logger_name, limit_level, fommatter, sinks, metrics) {}
 
 protected:
-    virtual void log(const char *data, size_t len = 0) override {
+    // 同步输出不排队，等级只供异步工作器的溢出策略使用
+    virtual void log(const char *data, size_t len,
+                     LogLevel::Value /*level*/) override {
         std::lock_guard<std::mutex> lock(_mutex);
-        if (_sinks.empty()) return;
-        for (auto &sink : _sinks) {
-            sink->log(data, len);
+        if (_routed) {
+            struct iovec iov;
+            iov.iov_base = const_cast<char *>(data);
+            iov.iov_len = len;
+            writeRouted(&iov, 1);
+            return;
         }
+        for (size_t i = 0; i < _sinks.size(); i++) sinkLog(i, data, len);
     }
 };
 
 class AsyncLogger : public Logger {
 public:
+    // deferred_format为true时，生产者只写入格式串指针和参数的原始值，
+    // vsnprintf和Formatter都在工作线程中执行；要求fmt和file在落地前保持有效。
+    // format_threads大于1时(仅deferred_format有效)，由多个线程并行格式化，
+    // 写出顺序与批次顺序一致；looper_config.metrics非空时开启统计
     AsyncLogger(const std::string &logger_name, LogLevel::Value &limit_level,
                 const Formatter::ptr &fommatter,
-                std::vector<LogSink::ptr> sinks, LooperType looper_type)
-        : Logger(logger_name, limit_level, fommatter, sinks),
-          _looper(std::make_shared<AsyncLooper>(
+                std::vector<LogSink::ptr> sinks,
+                const LooperConfig &looper_config,
+                bool deferred_format = false, size_t format_threads = 0)
+        : Logger(logger_name, limit_level, fommatter, sinks,
+                 looper_config.metrics),
+          _deferred_format(deferred_format),
+          _drop_report_interval(looper_config.drop_report_interval),
+          _reported_msgs(0),
+          _reported_bytes(0),
+          _pipeline(createPipeline(deferred_format, format_threads)),
+          _looper(createLooper(
               std::bind(&AsyncLogger::asyncLog, this, std::placeholders::_1),
-              looper_type)) {}
+              looper_config)) {
+        _backend_iov.reserve(DEFAULT_BUFFER_SIZE / BUFFER_CHUNK_SIZE * 2);
+    }
+    ~AsyncLogger() {
+        // 先处理完剩余数据，再补充最后一次丢弃统计
+        _looper->stop();
+        if (_pipeline) _pipeline->stop();
+        reportDropped(true);
+    }
+
+    // 已写满、等待落地或正在落地的缓冲区数量及其峰值；
+    // 峰值接近缓冲区总数说明落地速度跟不上，生产者即将触发溢出策略
+    size_t inflightBuffers() const { return _looper->inflightBuffers(); }
+    size_t peakInflightBuffers() const {
+        return _looper->peakInflightBuffers();
+    }
+
+    MetricsSnapshot metrics() const override {
+        MetricsSnapshot res = Logger::metrics();
+        res.dropped_msgs = _looper->droppedMessages();
+        res.dropped_bytes = _looper->droppedBytes();
+        res.inflight_buffers = _looper->inflightBuffers();
+        res.peak_inflight_buffers = _looper->peakInflightBuffers();
+        return res;
+    }
 
 protected:
-    virtual void log(const char *data, size_t len = 0) override {
-        _looper->push(data, len);
+    void logv(LogLevel::Value level, const char *file, size_t line,
+              const char *fmt, va_list ap) override {
+        if (!_deferred_format) {
+            Logger::logv(level, file, line, fmt, ap);
+            return;
+        }
+        if (!sinkAccepts(level)) return;
+        std::string &record = scratch().out;
+        record.clear();
+        DeferredRecord::encode(record, level, file, line, fmt, ap);
+        _looper->push(record.data(), record.size(), level);
+        if (record.capacity() > kScratchKeepSize) std::string().swap(record);
+    }
+
+    void logFields(LogLevel::Value level, const char *file, size_t line,
+                   std::string_view msg, const Field *fields,
+                   size_t count) override {
+        if (!_deferred_format) {
+            Logger::logFields(level, file, line, msg, fields, count);
+            return;
+        }
+        if (!sinkAccepts(level)) return;
+        std::string &record = scratch().out;
+        record.clear();
+        DeferredRecord::encodeFields(record, level, file, line, msg, fields,
+                                     count);
+        _looper->push(record.data(), record.size(), level);
+        if (record.capacity() > kScratchKeepSize) std::string().swap(record);
+    }
+
+    virtual void log(const char *data, size_t len,
+                     LogLevel::Value level) override {
+        _looper->push(data, len, level);
     }
 
     // 实际落地函数
     void asyncLog(Buffer &buffer) {
+        reportDropped(false);
+        if (_pipeline) {
+            _pipeline->submit(buffer);
+            return;
+        }
+        if (_deferred_format) {
+            formatRecords(buffer, _backend_payload, _backend_out);
+            if (_has_queued && !_routed) {
+                // 格式化结果交换进批次，不拷贝
+                SinkBatch::ptr batch = _batches.acquire();
+                batch->text.swap(_backend_out);
+                batch->fromText();
+                writeBatch(batch);
+                return;
+            }
+            writeSinks(_backend_out.data(), _backend_out.size());
+            if (_backend_out.capacity() > kScratchKeepSize)
+                std::string().swap(_backend_out);
+            return;
+        }
+        if (_has_queued && !_routed) {
+            // 批次接管工作器的缓冲区，工作器换回批次中已清空的缓冲区
+            SinkBatch::ptr batch = _batches.acquire();
+            batch->buffer.swap(buffer);
+            batch->fromBuffer();
+            writeBatch(batch);
+            return;
+        }
+        // 各块直接交给落地方向，不再拼接
+        buffer.readv(_backend_iov);
+        writeSinks(_backend_iov.data(), (int)_backend_iov.size());
+    }
+
+    // 带独立队列的落地方向只是入队，其余落地方向在当前线程中写出
+    void writeBatch(const SinkBatch::ptr &batch) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (size_t i = 0; i < _sinks.size(); i++) {
+            if (_queued[i])
+                _queued[i]->push(batch);
+            else
+                sinkLogv(i, batch->iov.data(), (int)batch->iov.size());
+        }
+    }
+
+    void writeSinks(const char *data, size_t len) {
+        if (_has_queued || _routed) {
+            struct iovec iov;
+            iov.iov_base = const_cast<char *>(data);
+            iov.iov_len = len;
+            writeSinks(&iov, 1);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (size_t i = 0; i < _sinks.size(); i++) sinkLog(i, data, len);
+    }
+
+    // 数据属于调用方(并行格式化的输出、丢弃统计)，有落地队列时拷贝一次，
+    // 所有队列共用这一份
+    void writeSinks(const struct iovec *iov, int iovcnt) {
+        if (_routed) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            writeRouted(iov, iovcnt);
+            return;
+        }
+        if (_has_queued) {
+            SinkBatch::ptr batch = _batches.acquire();
+            batch->copy(iov, iovcnt);
+            writeBatch(batch);
+            return;
+        }
         std::lock_guard<std::mutex> lock(_mutex);
-        if (_sinks.empty()) return;
-        for (auto &sink : _sinks) {
-            sink->log(buffer.begin(), buffer.readableSize());
+        for (size_t i = 0; i < _sinks.size(); i++) sinkLogv(i, iov, iovcnt);
+    }
+
+    // 在工作线程中解码整批记录，格式化结果写入out；
+    // 记录不会跨块，逐块解码即可
+    void formatRecords(Buffer &buffer, std::string &payload, std::string &out) {
+        out.clear();
+        static thread_local std::vector<struct iovec> regions;
+        buffer.readv(regions);
+        DeferredRecord::Header header;
+        std::string_view fields;
+        for (auto &region : regions) {
+            const char *data = (const char *)region.iov_base;
+            size_t len = region.iov_len;
+            while (len > 0) {
+                payload.clear();
+                size_t n = DeferredRecord::decode(data, len, header, payload,
+                                                  fields);
+                if (n == 0) break;
+                LogMsg msg((time_t)header.time, header.nsec,
+                           (LogLevel::Value)header.level, _logger_name,
+                           header.file, header.line, header.tid,
+                           (pid_t)header.ktid, payload);
+                msg._fields = fields;
+                if (_routed) {
+                    formatRouted(out, msg);
+                } else {
+                    ScopedLatency timer(
+                        sampleOf<&PipelineMetrics::format_ns>(_metrics.get()));
+                    _formatter->format(out, msg);
+                }
+                data += n;
+                len -= n;
+            }
+        }
+    }
+
+    // 溢出策略丢弃了日志时，按间隔向日志流中写入一条统计
+    void reportDropped(bool force) {
+        uint64_t msgs = _looper->droppedMessages();
+        if (msgs == _reported_msgs) return;
+        auto now = std::chrono::steady_clock::now();
+        if (!force && now - _last_drop_report < _drop_report_interval) return;
+        uint64_t bytes = _looper->droppedBytes();
+        char text[128];
+        int n = snprintf(text, sizeof(text),
+                         "%llu messages (%llu bytes) dropped by overflow policy",
+                         (unsigned long long)(msgs - _reported_msgs),
+                         (unsigned long long)(bytes - _reported_bytes));
+        _reported_msgs = msgs;
+        _reported_bytes = bytes;
+        _last_drop_report = now;
+        LogMsg msg(LogLevel::Value::WARNING, _logger_name, __FILE__, __LINE__,
+                   std::string_view(text, n));
+        std::string report;
+        if (_routed)
+            formatRouted(report, msg);
+        else
+            _formatter->format(report, msg);
+        // 并行格式化时经过重排阶段，排在已提交的批次之后
+        if (_pipeline) {
+            _pipeline->submitFormatted(report);
+            return;
         }
+        writeSinks(report.data(), report.size());
     }
 
-    AsyncLooper::ptr _looper;
+    // 格式化线程使用线程局部的有效消息缓冲区
+    OrderedPipeline::ptr createPipeline(bool deferred_format,
+                                        size_t format_threads) {
+        if (!deferred_format || format_threads <= 1) return nullptr;
+        return std::make_shared<OrderedPipeline>(
+            format_threads,
+            [this](Buffer &buffer, std::string &out) {
+                formatRecords(buffer, scratch().payload, out);
+            },
+            [this](const struct iovec *iov, int iovcnt) {
+                writeSinks(iov, iovcnt);
+            });
+    }
+
+    // 根据配置选择双缓冲区或每线程环形缓冲区
+    static Looper::ptr createLooper(const Func &cb,
+                                    const LooperConfig &config) {
+        if (config.ring) return std::make_shared<RingLooper>(cb, config);
+        return std::make_shared<AsyncLooper>(cb, config);
+    }
+
+    bool _deferred_format;
+    // 丢弃统计(只在工作线程中访问)
+    std::chrono::milliseconds _drop_report_interval;
+    std::chrono::steady_clock::time_point _last_drop_report;
+    uint64_t _reported_msgs;
+    uint64_t _reported_bytes;
+    std::string _backend_payload;  // 工作线程使用：还原的有效消息
+    std::string _backend_out;      // 工作线程使用：整批格式化结果
+    std::vector<struct iovec> _backend_iov;  // 工作线程使用：缓冲区各块
+    OrderedPipeline::ptr _pipeline;  // 并行格式化，为空时在工作线程中格式化
+    Looper::ptr _looper;
 };
 
 // 使用建造者模式构造日志器
 enum class LoggerType { SYNC, ASYNC };
 
+// 由LoggerManager持有的共享线程池，定义在LoggerManager之后
+inline LooperExecutor::ptr sharedExecutor();
+
 // 1. 抽象日志器建造者类（这里先决定同步还是异步）
 class LoggerBuilder {
 public:
     LoggerBuilder()
         : _logger_type(LoggerType::ASYNC),
           _limit_level(LogLevel::Value::DEBUG),
-          _looper_type(LooperType::SAFE) {}
+          _looper_config(LooperType::SAFE),
+          _deferred_format(false),
+          _format_threads(0),
+          _shared_backend(false),
+          _enable_metrics(false),
+          _metrics_sample(DEFAULT_METRICS_SAMPLE) {}
     void buildType(const LoggerType &logger_type) {
         _logger_type = logger_type;
     }
 
-    void enableUnsafeAsync() { _looper_type = LooperType::UNSAFE; }
+    void enableUnsafeAsync() { _looper_config.type = LooperType::UNSAFE; }
+    // 缓冲区满时的处理策略，见LooperType
+    void buildOverflowPolicy(LooperType looper_type) {
+        _looper_config.type = looper_type;
+    }
+    // BLOCK_TIMEOUT策略的最长等待时间
+    void buildBlockTimeout(std::chrono::milliseconds timeout) {
+        _looper_config.block_timeout = timeout;
+    }
+    // DROP_BELOW_LEVEL策略下不会被丢弃的最低等级
+    void buildKeepLevel(LogLevel::Value keep_level) {
+        _looper_config.keep_level = keep_level;
+    }
+    // 丢弃统计写入日志流的最小间隔
+    void buildDropReportInterval(std::chrono::milliseconds interval) {
+        _looper_config.drop_report_interval = interval;
+    }
+    // 异步缓冲区总数(至少2)，落地出现短暂停顿时由空闲缓冲区吸收
+    void buildBufferCount(size_t count) { _looper_config.buffer_count = count; }
+    // 待处理数据达到bytes字节或count条时才唤醒工作线程，为0表示不使用该阈值
+    void buildWakeThreshold(size_t bytes, size_t count = 0) {
+        _looper_config.wake_bytes = bytes;
+        _looper_config.wake_count = count;
+    }
+    // 未达到唤醒阈值的数据最多等待interval就落地
+    void buildFlushInterval(std::chrono::milliseconds interval) {
+        _looper_config.flush_interval = interval;
+    }
+    // 工作线程空闲时的等待方式，spins为让出CPU或休眠前的自旋次数
+    void buildIdleStrategy(IdleStrategy strategy,
+                           size_t spins = DEFAULT_IDLE_SPINS) {
+        _looper_config.idle_strategy = strategy;
+        _looper_config.idle_spins = spins;
+    }
+    // 每个生产者线程使用独立的环形缓冲区，避免多线程竞争同一把锁
+    void enableRingLooper(size_t ring_size = DEFAULT_RING_SIZE) {
+        _looper_config.ring = true;
+        _looper_config.ring_size = ring_size;
+    }
+
+    // 格式化工作移到异步工作线程，仅对异步日志器有效；
+    // 格式串和文件名只保存指针，需要是字面量或在日志器销毁前保持有效
+    void enableDeferredFormat() { _deferred_format = true; }
+
+    // 在延迟格式化的基础上，由thread_count个线程并行格式化同一日志器的批次，
+    // 落地顺序保持不变
+    void enableParallelFormat(size_t thread_count) {
+        _deferred_format = true;
+        _format_threads = thread_count;
+    }
+
+    // 不创建独立的工作线程，由LoggerManager的共享线程池处理，
+    // 线程数通过LoggerManager::setBackendThreads设置
+    void enableSharedBackend() { _shared_backend = true; }
+
+    // 记录入队耗时、阻塞时间、批次大小、格式化和落地耗时等统计，
+    // 通过Logger::metrics或LoggerManager::metrics读取；
+    // 入队和格式化耗时每个线程每sample_every次采样一次
+    void enableMetrics(size_t sample_every = DEFAULT_METRICS_SAMPLE) {
+        _enable_metrics = true;
+        _metrics_sample = sample_every;
+    }
 
     void buildName(const std::string logger_name) {
         _logger_name = logger_name;
@@ -220,24 +785,56 @@ public:
     void buildLimitLevel(const LogLevel::Value &limit_level) {
         _limit_level = limit_level;
     }
-    void buildFommatter(
-        const std::string pattern = "[%d{%H:%M:%S}][%t][%c][%p][%f:%l]%T%m%n") {
+    void buildFommatter(const std::string pattern = DEFAULT_PATTERN) {
         _formatter = std::make_shared<Formatter>(pattern);
     }
+    // 格式在编译期已知时使用，例如：
+    //   inline constexpr char kPattern[] = "[%p]%m%n";
+    //   builder->buildStaticFommatter<kPattern>();
+    template <const char *Pattern>
+    void buildStaticFommatter() {
+        _formatter = Formatter::createStatic<Pattern>();
+    }
     template <typename SinkType, typename... Args>
     void buildSink(Args &&...args) {
         auto sink = SinkFactory::create<SinkType>(std::forward<Args>(args)...);
         _sinks.push_back(sink);
     }
+    // 添加已经构造好的落地方向
+    void buildSink(const LogSink::ptr &sink) { _sinks.push_back(sink); }
+    // 添加落地方向并指定它自己的最低等级，pattern非空时使用自己的格式
+    void buildSink(const LogSink::ptr &sink, LogLevel::Value level,
+                   const std::string &pattern = std::string()) {
+        sink->setLevel(level);
+        if (!pattern.empty()) sink->setPattern(pattern);
+        _sinks.push_back(sink);
+    }
+    // 添加带独立队列和写线程的落地方向，落地较慢时不影响其他落地方向
+    void buildQueuedSink(const LogSink::ptr &sink,
+                         const SinkQueueConfig &config = SinkQueueConfig()) {
+        _sinks.push_back(std::make_shared<QueuedSink>(sink, config));
+    }
     virtual Logger::ptr build() = 0;
 
 protected:
+    // 统计对象在落地方向确定之后创建，未开启时为空
+    PipelineMetrics::ptr createMetrics() {
+        if (!_enable_metrics) return nullptr;
+        return std::make_shared<PipelineMetrics>(_sinks.size(),
+                                                 _metrics_sample);
+    }
+
     LoggerType _logger_type;
     std::string _logger_name;
     LogLevel::Value _limit_level;      // 日志输出限制等级
     Formatter::ptr _formatter;         // 格式化
     std::vector<LogSink::ptr> _sinks;  // 日志落地位置（可以多选）
-    LooperType _looper_type;
+    LooperConfig _looper_config;
+    bool _deferred_format;
+    size_t _format_threads;
+    bool _shared_backend;
+    bool _enable_metrics;
+    size_t _metrics_sample;
 };
 
 // 2. 派生出具体的建造者类型（局部或全局）
@@ -252,12 +849,16 @@ public:
         if (_sinks.empty()) {
             buildSink<StdoutSink>();
         }
+        _looper_config.metrics = createMetrics();
         if (_logger_type == LoggerType::ASYNC) {
+            if (_shared_backend) _looper_config.executor = sharedExecutor();
             return std::make_shared<AsyncLogger>(
-                _logger_name, _limit_level, _formatter, _sinks, _looper_type);
+                _logger_name, _limit_level, _formatter, _sinks, _looper_config,
+                _deferred_format, _format_threads);
         }
         return std::make_shared<SyncLogger>(_logger_name, _limit_level,
-                                            _formatter, _sinks);
+                                            _formatter, _sinks,
+                                            _looper_config.metrics);
     }
 };
 
@@ -269,51 +870,204 @@ public:
         return eton;
     }
 
+    // 写入方复制当前快照，插入后整体替换；读取方不加锁
     void addLogger(Logger::ptr &logger) {
-        if (hasLogger(logger->getName())) return;
         std::lock_guard<std::mutex> guard(_mutex);
-        _loggers.insert(std::make_pair(logger->getName(), logger));
+        const LoggerMap *cur = _snapshot.load();
+        if (cur->count(logger->getName())) return;
+        LoggerMap *next = new LoggerMap(*cur);
+        next->emplace(logger->getName(), logger);
+        publish(next);
     }
 
     bool hasLogger(const std::string &logger_name) {
-        std::lock_guard<std::mutex> guard(_mutex);
-        auto it = _loggers.find(logger_name);
-        if (it == _loggers.end()) {
-            return false;
-        }
-        return true;
+        ReadGuard guard(*this);
+        const LoggerMap *loggers = guard.get();
+        return loggers->find(logger_name) != loggers->end();
     }
 
     Logger::ptr getLogger(const std::string &logger_name) {
-        // std::cout << "开始查找" << std::endl;
-        std::lock_guard<std::mutex> guard(_mutex);
-        auto it = _loggers.find(logger_name);
-        if (it == _loggers.end()) {
-            // std::cout << "没找到" << std::endl;
-            return Logger::ptr();
-        }
-        // std::cout << "找到了" << std::endl;
+        ReadGuard guard(*this);
+        const LoggerMap *loggers = guard.get();
+        auto it = loggers->find(logger_name);
+        if (it == loggers->end()) return Logger::ptr();
         return it->second;
     }
 
-    Logger::ptr rootLogger() { return _root_logger; }
+    const Logger::ptr &rootLogger() { return _root_logger; }
+
+    // 所有已注册日志器的统计快照，按名称索引
+    std::unordered_map<std::string, MetricsSnapshot> metrics() {
+        std::unordered_map<std::string, MetricsSnapshot> res;
+        ReadGuard guard(*this);
+        const LoggerMap *loggers = guard.get();
+        for (auto &it : *loggers) res.emplace(it.first, it.second->metrics());
+        return res;
+    }
+
+    // 共享线程池的线程数，需要在第一个使用共享线程池的日志器创建之前设置
+    void setBackendThreads(size_t thread_count) {
+        std::lock_guard<std::mutex> guard(_mutex);
+        _backend_threads = thread_count;
+    }
+
+    // 共享线程池在第一次使用时创建，生命周期由管理器持有
+    LooperExecutor::ptr executor() {
+        std::lock_guard<std::mutex> guard(_mutex);
+        if (!_executor)
+            _executor = std::make_shared<LooperExecutor>(_backend_threads);
+        return _executor;
+    }
 
 private:
-    LoggerManager() {
+    LoggerManager()
+        : _backend_threads(DEFAULT_BACKEND_THREADS),
+          _snapshot(new LoggerMap()),
+          _slots(nullptr) {
         std::unique_ptr<wlog::LoggerBuilder> builder(
             new wlog::LocalLoggerBuilder());
         builder->buildName("_root_logger");
         _root_logger = builder->build();
         addLogger(_root_logger);
     }
-    ~LoggerManager() {}
+    ~LoggerManager() {
+        // 先释放日志器，让它们在线程池仍运行时处理完剩余数据
+        for (const LoggerMap *loggers : _retired) delete loggers;
+        _retired.clear();
+        delete _snapshot.exchange(nullptr);
+        _root_logger.reset();
+        if (_executor) _executor->stop();
+    }
+
+    using LoggerMap = std::unordered_map<std::string, Logger::ptr>;
+
+    // 读取方的危险指针：每个线程独占一个槽位(独占缓存行)，读取期间记录
+    // 正在使用的快照，读取方之间不共享任何被写的缓存行
+    struct alignas(64) ReaderSlot {
+        std::atomic<const LoggerMap *> snapshot{nullptr};
+        std::atomic<bool> in_use{false};
+        ReaderSlot *next = nullptr;  // 槽位链表，只在头部插入，槽位不释放
+    };
+
+    // 线程持有的槽位，线程退出时归还给其他线程复用
+    struct LocalReader {
+        ReaderSlot *slot = nullptr;
+        size_t depth = 0;  // 嵌套读取时只由最外层设置和清除槽位
+        ~LocalReader() {
+            if (slot) slot->in_use.store(false, std::memory_order_release);
+        }
+    };
+    static LocalReader &localReader() {
+        static thread_local LocalReader reader;
+        return reader;
+    }
+
+    ReaderSlot *acquireSlot() {
+        for (ReaderSlot *slot = _slots.load(std::memory_order_acquire); slot;
+             slot = slot->next) {
+            bool expected = false;
+            if (!slot->in_use.load(std::memory_order_relaxed) &&
+                slot->in_use.compare_exchange_strong(expected, true))
+                return slot;
+        }
+        // 不释放：线程退出后槽位留给其他线程，管理器析构后也不会悬空
+        ReaderSlot *slot = new ReaderSlot();
+        slot->in_use.store(true, std::memory_order_relaxed);
+        ReaderSlot *head = _slots.load(std::memory_order_relaxed);
+        do {
+            slot->next = head;
+        } while (!_slots.compare_exchange_weak(head, slot,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed));
+        return slot;
+    }
+
+    // 读取期间保护当前快照：先登记再确认快照没有被替换，
+    // 写入方替换之后扫描槽位时一定能看到登记(两侧都是seq_cst)
+    class ReadGuard {
+    public:
+        explicit ReadGuard(LoggerManager &manager)
+            : _reader(localReader()) {
+            if (_reader.depth++ == 0) {
+                if (!_reader.slot) _reader.slot = manager.acquireSlot();
+                const LoggerMap *loggers = manager._snapshot.load();
+                while (true) {
+                    _reader.slot->snapshot.store(loggers);
+                    const LoggerMap *cur = manager._snapshot.load();
+                    if (cur == loggers) break;
+                    loggers = cur;
+                }
+            }
+            _loggers =
+                _reader.slot->snapshot.load(std::memory_order_relaxed);
+        }
+        ~ReadGuard() {
+            if (--_reader.depth == 0)
+                _reader.slot->snapshot.store(nullptr,
+                                             std::memory_order_release);
+        }
+        const LoggerMap *get() const { return _loggers; }
+
+    private:
+        LocalReader &_reader;
+        const LoggerMap *_loggers;
+    };
+
+    // 发布新快照并释放旧快照(持有_mutex时调用)：
+    // 替换之后扫描所有槽位，没有被任何槽位登记的旧快照立即释放；
+    // 仍在被读取的留到下次写入再检查，因此留存的旧快照不超过同时读取的线程数
+    void publish(const LoggerMap *next) {
+        _retired.push_back(_snapshot.exchange(next));
+        std::vector<const LoggerMap *> in_use;
+        for (ReaderSlot *slot = _slots.load(); slot; slot = slot->next) {
+            const LoggerMap *loggers = slot->snapshot.load();
+            if (loggers) in_use.push_back(loggers);
+        }
+        size_t kept = 0;
+        for (const LoggerMap *loggers : _retired) {
+            if (std::find(in_use.begin(), in_use.end(), loggers) !=
+                in_use.end())
+                _retired[kept++] = loggers;
+            else
+                delete loggers;
+        }
+        _retired.resize(kept);
+    }
 
 private:
     std::mutex _mutex;
-    Logger::ptr _root_logger;  // 默认日志器
-    std::unordered_map<std::string, Logger::ptr> _loggers;
+    size_t _backend_threads;
+    LooperExecutor::ptr _executor;  // 共享线程池
+    Logger::ptr _root_logger;       // 默认日志器
+    std::atomic<const LoggerMap *> _snapshot;  // 当前的日志器表，只读
+    std::atomic<ReaderSlot *> _slots;          // 所有读取方槽位
+    std::vector<const LoggerMap *> _retired;  // 已被替换、仍有线程在读取的快照
 };
 
+// 调用点缓存的日志器：找到之后只做一次acquire读取，不再查表；
+// 日志器注册后不会被移除，缓存的指针在LoggerManager析构前一直有效
+class CachedLogger {
+public:
+    explicit CachedLogger(const char *name) : _name(name), _logger(nullptr) {}
+
+    // 日志器还没有注册时返回nullptr，之后的调用会重新查找
+    Logger *get() {
+        Logger *logger = _logger.load(std::memory_order_acquire);
+        if (logger != nullptr) return logger;
+        logger = LoggerManager::getInstance().getLogger(_name).get();
+        if (logger != nullptr) _logger.store(logger, std::memory_order_release);
+        return logger;
+    }
+
+private:
+    const char *_name;
+    std::atomic<Logger *> _logger;
+};
+
+inline LooperExecutor::ptr sharedExecutor() {
+    return LoggerManager::getInstance().executor();
+}
+
 // 全局
 class GlobalLoggerBuilder : public LoggerBuilder {
 public:
@@ -326,12 +1080,16 @@ public:
             buildSink<StdoutSink>();
         }
         Logger::ptr logger;
+        _looper_config.metrics = createMetrics();
         if (_logger_type == LoggerType::ASYNC) {
+            if (_shared_backend) _looper_config.executor = sharedExecutor();
             logger = std::make_shared<AsyncLogger>(
-                _logger_name, _limit_level, _formatter, _sinks, _looper_type);
+                _logger_name, _limit_level, _formatter, _sinks, _looper_config,
+                _deferred_format, _format_threads);
         } else {
             logger = std::make_shared<SyncLogger>(_logger_name, _limit_level,
-                                                  _formatter, _sinks);
+                                                  _formatter, _sinks,
+                                                  _looper_config.metrics);
         }
         LoggerManager::getInstance().addLogger(logger);
         return logger;
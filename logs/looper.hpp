@@ -1,83 +1,468 @@
 // 异步日志的工作线程封装
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include "buffer.hpp"
+#include "executor.hpp"
+#include "level.hpp"
+#include "metrics.hpp"
 namespace wlog {
 using Func = std::function<void(Buffer&)>;
 
-enum class LooperType { SAFE, UNSAFE };
+// 缓冲区满时的处理策略
+//   SAFE: 阻塞生产者直到有空间
+//   UNSAFE: 无限扩容，不阻塞也不丢弃
+//   DROP_NEWEST: 丢弃当前这条日志
+//   DROP_OLDEST: 丢弃缓冲区中最早的日志，为当前日志腾出空间
+//   BLOCK_TIMEOUT: 最多阻塞block_timeout，超时后丢弃当前日志
+//   DROP_BELOW_LEVEL: 低于keep_level的日志直接丢弃，其余日志阻塞等待
+enum class LooperType {
+    SAFE,
+    UNSAFE,
+    DROP_NEWEST,
+    DROP_OLDEST,
+    BLOCK_TIMEOUT,
+    DROP_BELOW_LEVEL
+};
+
+// 消费者空闲时的等待方式
+//   BUSY_SPIN: 一直自旋，唤醒延迟最低，独占一个CPU核
+//   SPIN_YIELD: 自旋idle_spins次后反复让出CPU，不进入休眠
+//   SPIN_PARK: 自旋idle_spins次后在条件变量上休眠，生产者需要时才唤醒
+enum class IdleStrategy { BUSY_SPIN, SPIN_YIELD, SPIN_PARK };
+
+#define DEFAULT_RING_SIZE (256 * 1024)
+#define DEFAULT_BUFFER_COUNT 4
+#define DEFAULT_WAKE_BYTES (64 * 1024)
+#define DEFAULT_FLUSH_INTERVAL 100  // 毫秒
+#define DEFAULT_IDLE_SPINS 100
+
+// 工作器配置
+//   type: 缓冲区满时的处理策略
+//   ring: 是否使用每线程环形缓冲区(RingLooper)代替双缓冲区
+//   executor: 非空时由共享线程池驱动，不再创建独立的消费线程
+//   buffer_count: AsyncLooper的缓冲区总数(至少2)，落地较慢时先消耗空闲缓冲区
+//   wake_bytes/wake_count: 待处理数据达到字节数或条数阈值时才唤醒消费者，
+//       为0表示不使用该阈值(两者都为0时每条日志都唤醒)；
+//       RingLooper不统计条数，只使用字节阈值
+//   flush_interval: 未达到阈值的数据最多等待这么久就会被处理
+//   idle_strategy/idle_spins: 消费者空闲时的等待方式
+//   使用共享线程池时每批数据只提交一次，不使用唤醒阈值和空闲策略
+//   metrics: 非空时记录入队耗时、阻塞时间、缓冲区交换时的数据量和批次大小，
+//       见metrics.hpp
+struct LooperConfig {
+    LooperConfig(LooperType looper_type = LooperType::SAFE)
+        : type(looper_type),
+          ring(false),
+          ring_size(DEFAULT_RING_SIZE),
+          buffer_count(DEFAULT_BUFFER_COUNT),
+          wake_bytes(DEFAULT_WAKE_BYTES),
+          wake_count(0),
+          flush_interval(DEFAULT_FLUSH_INTERVAL),
+          idle_strategy(IdleStrategy::SPIN_PARK),
+          idle_spins(DEFAULT_IDLE_SPINS),
+          block_timeout(10),
+          keep_level(LogLevel::Value::WARNING),
+          drop_report_interval(1000) {}
+
+    LooperType type;
+    bool ring;         // 使用每线程环形缓冲区
+    size_t ring_size;  // 每个生产者线程的环形缓冲区大小
+    size_t buffer_count;  // 缓冲区总数
+    size_t wake_bytes;    // 唤醒消费者的字节阈值
+    size_t wake_count;    // 唤醒消费者的条数阈值
+    std::chrono::milliseconds flush_interval;  // 未达到阈值时的最长等待时间
+    IdleStrategy idle_strategy;
+    size_t idle_spins;  // 让出CPU或休眠之前的自旋次数
+    std::chrono::milliseconds block_timeout;  // BLOCK_TIMEOUT的最长等待时间
+    LogLevel::Value keep_level;  // DROP_BELOW_LEVEL时不丢弃的最低等级
+    std::chrono::milliseconds drop_report_interval;  // 丢弃统计的输出间隔
+    LooperExecutor::ptr executor;  // 共享线程池
+    PipelineMetrics::ptr metrics;  // 统计，为空时不记录
+};
+
+// 自旋等待时提示CPU降低功耗，并让出流水线给同核的其他超线程
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+// 消费者空闲等待的自旋阶段：ready()为真或到达deadline时返回true；
+// SPIN_PARK自旋idle_spins次仍未就绪时返回false，由调用方休眠到deadline
+template <typename Ready>
+bool idleSpin(const LooperConfig& config,
+              std::chrono::steady_clock::time_point deadline, Ready ready) {
+    for (size_t i = 0;; i++) {
+        if (ready()) return true;
+        // 每64次才读一次时钟
+        if ((i & 63) == 63 && std::chrono::steady_clock::now() >= deadline)
+            return true;
+        switch (config.idle_strategy) {
+            case IdleStrategy::BUSY_SPIN:
+                cpuRelax();
+                break;
+            case IdleStrategy::SPIN_YIELD:
+                if (i < config.idle_spins)
+                    cpuRelax();
+                else
+                    std::this_thread::yield();
+                break;
+            case IdleStrategy::SPIN_PARK:
+            default:
+                if (i >= config.idle_spins) return false;
+                cpuRelax();
+                break;
+        }
+    }
+}
+
+// 工作器基类：AsyncLogger只依赖push/stop，消费线程通过Func回调落地数据；
+// 使用共享线程池时由线程池调用runBatch，每次处理一批数据
+class Looper : public ExecutorTask,
+               public std::enable_shared_from_this<Looper> {
+public:
+    using ptr = std::shared_ptr<Looper>;
+    Looper() : _dropped_msgs(0), _dropped_bytes(0) {}
+    virtual ~Looper() {}
+    // level用于DROP_BELOW_LEVEL策略
+    virtual void push(const char* data, size_t len,
+                      LogLevel::Value level = LogLevel::Value::OFF) = 0;
+    virtual void stop() = 0;
+
+    // 因溢出策略被丢弃的日志条数和字节数
+    uint64_t droppedMessages() const {
+        return _dropped_msgs.load(std::memory_order_relaxed);
+    }
+    uint64_t droppedBytes() const {
+        return _dropped_bytes.load(std::memory_order_relaxed);
+    }
+
+    // 已写满、等待落地或正在落地的缓冲区数量，以及历史峰值
+    virtual size_t inflightBuffers() const { return 0; }
+    virtual size_t peakInflightBuffers() const { return 0; }
+
+protected:
+    void recordDrop(size_t len, size_t msgs = 1) {
+        _dropped_msgs.fetch_add(msgs, std::memory_order_relaxed);
+        _dropped_bytes.fetch_add(len, std::memory_order_relaxed);
+    }
 
-class AsyncLooper {
+private:
+    std::atomic<uint64_t> _dropped_msgs;
+    std::atomic<uint64_t> _dropped_bytes;
+};
+
+// 多缓冲区工作器：
+//   1. 生产者写当前缓冲区，写满后放入待落地队列，再从空闲池取一个空缓冲区继续写
+//   2. 消费者逐个取出待落地的缓冲区调用回调，处理完后放回空闲池
+//   3. 落地较慢时只会消耗空闲缓冲区，全部用完才按溢出策略处理
+//   4. 有缓冲区写满或达到唤醒阈值时才唤醒消费者，且只在消费者休眠时才通知条件变量
+class AsyncLooper : public Looper {
 public:
     using ptr = std::shared_ptr<AsyncLooper>;
-    AsyncLooper(const Func& cb, LooperType looper_type = LooperType::SAFE)
+    AsyncLooper(const Func& cb, const LooperConfig& config = LooperConfig())
         : _running(true),
-          _thread(std::thread(&AsyncLooper::threadEntry, this)),
-          _looper_type(looper_type),
-          _callback(cb) {}
+          _pro_buffer(new Buffer()),
+          _pro_msgs(0),
+          _pro_lens_head(0),
+          _inflight(0),
+          _peak_inflight(0),
+          _wake(false),
+          _parked(false),
+          _callback(cb),
+          _looper_type(config.type),
+          _config(config),
+          _executor(config.executor),
+          _metrics(config.metrics.get()),
+          _scheduled(false),
+          _closed(false) {
+        // 预留队列空间，运行中收发缓冲区不再申请内存
+        size_t count = std::max<size_t>(2, config.buffer_count);
+        _full.reserve(count);
+        _empty.reserve(count);
+        for (size_t i = 1; i < count; i++)
+            _empty.emplace_back(new Buffer());
+        if (!_executor) _thread = std::thread(&AsyncLooper::threadEntry, this);
+    }
     ~AsyncLooper() { stop(); }
-    void stop() {
-        _running = false;
+    void stop() override {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _running = false;
+            _wake.store(true, std::memory_order_release);
+        }
         _cond_con.notify_all();  // 唤醒所有的工作线程
         _cond_pro.notify_all();
-        _thread.join();  // 等待工作线程退出
+        if (_thread.joinable()) _thread.join();  // 等待工作线程退出
+        if (_executor) {
+            // 在当前线程处理完剩余数据，之后线程池不再调用回调
+            while (runBatch()) {
+            }
+            std::lock_guard<std::mutex> run_lock(_run_mutex);
+            _closed = true;
+        }
     }
-    void push(const char* data, int len) {
-        // 1. 无限扩容，用于测试
-        // 2. 阻塞式，安全
+
+    // 线程池调用：处理一个缓冲区，仍有数据时返回true
+    bool runBatch() override {
+        std::lock_guard<std::mutex> run_lock(_run_mutex);
+        if (_closed) return false;
+        std::unique_ptr<Buffer> buffer;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (!takeBuffer(buffer)) {
+                _scheduled = false;
+                return false;
+            }
+        }
+        runCallback(*buffer);
+        std::unique_lock<std::mutex> lock(_mutex);
+        giveBack(buffer);
+        if (_full.empty() && _pro_buffer->empty()) {
+            _scheduled = false;
+            return false;
+        }
+        return true;
+    }
+
+    void push(const char* data, size_t len,
+              LogLevel::Value level = LogLevel::Value::OFF) override {
+        ScopedLatency timer(sampleOf<&PipelineMetrics::enqueue_ns>(_metrics));
         std::unique_lock<std::mutex> lock(_mutex);
-        // 条件变量
-        if (_looper_type == LooperType::SAFE)
-            _cond_pro.wait(
-                lock, [&]() { return len <= _pro_buffer.writeableSize(); });
+        // 空间不足时优先换一个空闲缓冲区，没有空闲缓冲区再按溢出策略处理
+        if (len > _pro_buffer->writeableSize() && !_pro_buffer->empty()) {
+            if (_empty.empty() && !makeRoom(lock, len, level)) {
+                recordDrop(len);
+                return;
+            }
+            if (len > _pro_buffer->writeableSize() && !_pro_buffer->empty() &&
+                !_empty.empty())
+                rotate();
+        }
         // 添加数据
-        _pro_buffer.push(data, len);
-        // 唤醒消费者
-        _cond_con.notify_one();
+        _pro_buffer->push(data, len);
+        _pro_msgs++;
+        if (_looper_type == LooperType::DROP_OLDEST) _pro_lens.push_back(len);
+        // 达到阈值才唤醒消费者；使用线程池时，未在就绪队列中才需要提交
+        if (!_executor) {
+            if (!_wake.load(std::memory_order_relaxed) && wakeCondition())
+                wakeConsumer();
+        } else if (!_scheduled) {
+            _scheduled = true;
+            lock.unlock();
+            _executor->schedule(weak_from_this());
+        }
+    }
+
+    size_t inflightBuffers() const override {
+        return _inflight.load(std::memory_order_relaxed);
+    }
+    size_t peakInflightBuffers() const override {
+        return _peak_inflight.load(std::memory_order_relaxed);
     }
 
 private:
+    struct FullBuffer {
+        std::unique_ptr<Buffer> buffer;
+        size_t msgs;  // 缓冲区中的日志条数
+    };
+
+    // 没有空闲缓冲区且当前缓冲区放不下时调用，返回false表示当前日志需要丢弃
+    bool makeRoom(std::unique_lock<std::mutex>& lock, size_t len,
+                  LogLevel::Value level) {
+        auto writable = [&]() {
+            return !_running || len <= _pro_buffer->writeableSize() ||
+                   _pro_buffer->empty() || !_empty.empty();
+        };
+        switch (_looper_type) {
+            case LooperType::UNSAFE:
+                return true;
+            case LooperType::DROP_NEWEST:
+                return _pro_buffer->empty();
+            case LooperType::BLOCK_TIMEOUT: {
+                wakeConsumer();
+                ScopedLatency blocked(blockedMetric(writable));
+                return _cond_pro.wait_for(lock, _config.block_timeout,
+                                          writable);
+            }
+            case LooperType::DROP_BELOW_LEVEL: {
+                if (level < _config.keep_level) return _pro_buffer->empty();
+                wakeConsumer();
+                ScopedLatency blocked(blockedMetric(writable));
+                _cond_pro.wait(lock, writable);
+                return true;
+            }
+            case LooperType::DROP_OLDEST:
+                dropOldest(len);
+                return true;
+            case LooperType::SAFE:
+            default: {
+                wakeConsumer();
+                ScopedLatency blocked(blockedMetric(writable));
+                _cond_pro.wait(lock, writable);
+                return true;
+            }
+        }
+    }
+
+    // 只有确实需要等待时才记录阻塞时间
+    template <typename Pred>
+    Histogram* blockedMetric(Pred writable) {
+        if (!_metrics || writable()) return nullptr;
+        return &_metrics->blocked_ns;
+    }
+
+    void runCallback(Buffer& buffer) {
+        if (_metrics) _metrics->batch_bytes.record(buffer.readableSize());
+        _callback(buffer);
+    }
+
+    // 有写满的缓冲区，或当前缓冲区达到唤醒阈值，调用方持有_mutex
+    bool wakeCondition() {
+        if (!_full.empty()) return true;
+        size_t bytes = _pro_buffer->readableSize();
+        if (_config.wake_bytes == 0 && _config.wake_count == 0)
+            return bytes > 0;
+        return (_config.wake_bytes > 0 && bytes >= _config.wake_bytes) ||
+               (_config.wake_count > 0 && _pro_msgs >= _config.wake_count);
+    }
+
+    // 设置唤醒标志，消费者休眠时才通知条件变量，调用方持有_mutex
+    void wakeConsumer() {
+        if (_executor) return;
+        _wake.store(true, std::memory_order_release);
+        if (_parked) _cond_con.notify_one();
+    }
+
+    // 有待落地的缓冲区时整块丢弃最早的一个；否则从当前缓冲区头部丢弃整条日志，
+    // 至少腾出len和1/8容量中较大者，再归还已读完的块
+    void dropOldest(size_t len) {
+        if (!_full.empty()) {
+            FullBuffer oldest = std::move(_full.front());
+            _full.erase(_full.begin());
+            recordDrop(oldest.buffer->readableSize(), oldest.msgs);
+            oldest.buffer->reset();
+            _empty.push_back(std::move(oldest.buffer));
+            _inflight.fetch_sub(1, std::memory_order_relaxed);
+            return;
+        }
+        size_t target = std::max(len, _pro_buffer->capacity() / 8);
+        size_t freed = 0;
+        while (freed < target && _pro_lens_head < _pro_lens.size()) {
+            size_t n = _pro_lens[_pro_lens_head++];
+            _pro_buffer->moveReader(n);
+            recordDrop(n);
+            _pro_msgs--;
+            freed += n;
+        }
+        _pro_buffer->compact();
+    }
+
+    // 当前缓冲区放入待落地队列，换一个空闲缓冲区，调用方持有_mutex
+    void rotate() {
+        if (_metrics) _metrics->fill_bytes.record(_pro_buffer->readableSize());
+        _full.push_back({std::move(_pro_buffer), _pro_msgs});
+        _pro_buffer = std::move(_empty.back());
+        _empty.pop_back();
+        _pro_msgs = 0;
+        _pro_lens.clear();
+        _pro_lens_head = 0;
+        size_t inflight = _inflight.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (inflight > _peak_inflight.load(std::memory_order_relaxed))
+            _peak_inflight.store(inflight, std::memory_order_relaxed);
+    }
+
+    // 消费者取出最早的待落地缓冲区；队列为空时取走当前缓冲区，调用方持有_mutex
+    bool takeBuffer(std::unique_ptr<Buffer>& buffer) {
+        if (_full.empty()) {
+            if (_pro_buffer->empty() || _empty.empty()) return false;
+            rotate();
+        }
+        buffer = std::move(_full.front().buffer);
+        _full.erase(_full.begin());
+        // 队列腾出了位置，唤醒全部生产者
+        _cond_pro.notify_all();
+        return true;
+    }
+
+    // 处理完的缓冲区放回空闲池，调用方持有_mutex
+    void giveBack(std::unique_ptr<Buffer>& buffer) {
+        buffer->reset();
+        _empty.push_back(std::move(buffer));
+        _inflight.fetch_sub(1, std::memory_order_relaxed);
+        _cond_pro.notify_all();
+    }
+
     void threadEntry() {
         while (1) {
+            // 等待唤醒标志，最多等待flush_interval
+            auto deadline =
+                std::chrono::steady_clock::now() + _config.flush_interval;
+            auto ready = [&]() {
+                return _wake.load(std::memory_order_acquire);
+            };
+            std::unique_ptr<Buffer> buffer;
             {
-                // 运行标志设为否且数据处理完毕，再退出，否则会导致数据处理不完全
-                if (!_running && _pro_buffer.empty()) {
-                    break;
+                std::unique_lock<std::mutex> lock(_mutex, std::defer_lock);
+                if (!idleSpin(_config, deadline, ready)) {
+                    lock.lock();
+                    _parked = true;
+                    _cond_con.wait_until(lock, deadline, ready);
+                    _parked = false;
+                } else {
+                    lock.lock();
                 }
-                std::unique_lock<std::mutex> lock(_mutex);
-                // 工作线程退出或者生产者缓冲区有数据唤醒线程
-                if (_looper_type == LooperType::SAFE) {
-                    _cond_con.wait(lock, [&]() {
-                        return !_running || !_pro_buffer.empty();
-                    });
+                // 运行标志设为否且数据处理完毕，再退出，否则会导致数据处理不完全
+                if (!takeBuffer(buffer)) {
+                    if (!_running && _full.empty() && _pro_buffer->empty())
+                        break;
+                    _wake.store(!_running, std::memory_order_relaxed);
+                    continue;
                 }
-                // 交换两个缓冲区
-                _con_buffer.swap(_pro_buffer);
-                // 唤醒全部生产者
-                _cond_pro.notify_all();
+                _wake.store(!_running || wakeCondition(),
+                            std::memory_order_relaxed);
             }
             // 处理数据
-            _callback(_con_buffer);
-            // 初始化消费者缓冲区
-            _con_buffer.reset();
+            runCallback(*buffer);
+            std::unique_lock<std::mutex> lock(_mutex);
+            giveBack(buffer);
         }
     }
 
 private:
-    bool _running;       // 工作停止标志
-    Buffer _pro_buffer;  // 生产缓冲区
-    Buffer _con_buffer;  // 消费缓冲区
+    bool _running;  // 工作停止标志(受_mutex保护)
+    std::unique_ptr<Buffer> _pro_buffer;  // 生产缓冲区
+    size_t _pro_msgs;                     // 生产缓冲区中的日志条数
+    std::vector<FullBuffer> _full;        // 待落地的缓冲区(按写满顺序)
+    std::vector<std::unique_ptr<Buffer>> _empty;  // 空闲缓冲区
+    std::vector<uint32_t> _pro_lens;  // DROP_OLDEST：生产缓冲区中每条日志的长度
+    size_t _pro_lens_head;            // 已丢弃的日志条数
+    std::atomic<size_t> _inflight;       // 待落地和正在落地的缓冲区数量
+    std::atomic<size_t> _peak_inflight;  // _inflight的历史峰值
+    std::atomic<bool> _wake;  // 消费者需要处理数据(在_mutex内修改，自旋时无锁读取)
+    bool _parked;             // 消费者在条件变量上休眠(受_mutex保护)
     std::mutex _mutex;
     std::condition_variable _cond_pro;  // 生产者条件变量
     std::condition_variable _cond_con;  // 消费者条件变量
-    std::thread _thread;                // 消费线程
     Func _callback;
     LooperType _looper_type;
+    LooperConfig _config;
+    LooperExecutor::ptr _executor;  // 共享线程池，为空时使用独立的消费线程
+    PipelineMetrics* _metrics;      // 统计(由_config持有)，为空时不记录
+    bool _scheduled;        // 是否已提交到线程池(受_mutex保护)
+    std::mutex _run_mutex;  // 保证同一时刻只有一个线程处理本工作器的数据
+    bool _closed;           // 已停止，线程池不再调用回调(受_run_mutex保护)
+    std::thread _thread;  // 独立的消费线程(在构造函数体中启动，此时其他成员已就绪)
 };
 }  // namespace wlog
@@ -5,33 +5,55 @@
 //   3. 日志器名称
 //   4. 源文件名称
 //   5. 源代码行号
-//   6. 线程ID
+//   6. 线程ID(std::thread::id和内核线程ID)
 //   7. 日志的有效消息
+//   8. 结构化字段(编码后的二进制形式，见fields.hpp)
+// 注意：字符串成员只是视图，不拥有内存，LogMsg只在格式化期间有效
 #pragma once
 
+#include <string_view>
 #include <thread>
 
 #include "level.hpp"
+#include "threadinfo.hpp"
 #include "util.hpp"
 
 namespace wlog {
 struct LogMsg {
     time_t _c_time;                // 当前时间
+    uint32_t _nsec;                // 秒内的纳秒数
     wlog::LogLevel::Value _level;  // 日志等级
-    std::string _logger;           // 日志器名称
-    std::string _file;             // 文件名称
+    std::string_view _logger;      // 日志器名称
+    std::string_view _file;        // 文件名称
     size_t _line;                  // 行号
     std::thread::id _tid;          // 线程ID
-    std::string _payload;          // 有效消息
+    pid_t _ktid;                   // 内核线程ID
+    std::string_view _payload;     // 有效消息
+    std::string_view _fields;      // 结构化字段，没有时为空
 
-    LogMsg(wlog::LogLevel::Value level, const std::string &logger,
-           const std::string file, const size_t line, const std::string &&msg)
-        : _c_time(date::now()),
-          _level(level),
+    LogMsg(wlog::LogLevel::Value level, std::string_view logger,
+           std::string_view file, const size_t line, std::string_view msg)
+        : _level(level),
           _logger(logger),
           _file(file),
           _line(line),
           _tid(std::this_thread::get_id()),
-          _payload(std::move(msg)) {}
+          _ktid(ThreadInfo::tid()),
+          _payload(msg) {
+        date::preciseNow(_c_time, _nsec);
+    }
+    // 延迟格式化时由消费线程还原，时间和线程ID来自生产者
+    LogMsg(time_t c_time, uint32_t nsec, wlog::LogLevel::Value level,
+           std::string_view logger, std::string_view file, const size_t line,
+           std::thread::id tid, pid_t ktid, std::string_view msg)
+        : _c_time(c_time),
+          _nsec(nsec),
+          _level(level),
+          _logger(logger),
+          _file(file),
+          _line(line),
+          _tid(tid),
+          _ktid(ktid),
+          _payload(msg) {}
 };
 }  // namespace wlog
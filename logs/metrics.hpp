@@ -0,0 +1,224 @@
+// 日志流水线的内置统计
+//   1. Histogram按2的幂分桶，记录一次只做几次relaxed原子加法，不加锁；
+//      按内核线程ID分成多片，多个生产者同时记录时不争用同一缓存行
+//   2. 快照时合并所有分片，给出次数、总和、最大值，分位数按桶的上界近似
+//   3. 统计默认关闭，由LoggerBuilder::enableMetrics开启；关闭时每个统计点
+//      只多一次空指针判断，不读时钟
+//   4. 每条日志都会经过的统计点(入队、格式化)按线程每sample_every次采样一次，
+//      读两次时钟的开销(约几十纳秒)分摊后可以忽略；每批一次或很少发生的
+//      统计点每次都记录
+//   5. 统计项：
+//        enqueue_ns   生产者调用push的耗时(含阻塞，采样)
+//        blocked_ns   生产者因缓冲区满而等待的时间，只在发生等待时记录
+//        fill_bytes   缓冲区交换时的数据量(环形缓冲区为每次取出的数据量)
+//        batch_bytes  每次交给落地回调的数据量
+//        format_ns    Formatter::format的耗时(每条日志，采样)
+//        sinks[i]     第i个落地方向每次写入的耗时和累计字节数
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "threadinfo.hpp"
+
+namespace wlog {
+struct HistogramSnapshot {
+    // 桶0只有0，桶i(i>=1)为[2^(i-1), 2^i)
+    static constexpr size_t kBuckets = 64;
+
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    uint64_t buckets[kBuckets] = {};
+
+    double mean() const { return count == 0 ? 0 : (double)sum / count; }
+
+    // p取0~1，返回该分位数所在桶的上界(不超过最大值)
+    uint64_t percentile(double p) const {
+        if (count == 0) return 0;
+        uint64_t rank = (uint64_t)(p * count);
+        if (rank >= count) rank = count - 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBuckets; i++) {
+            seen += buckets[i];
+            if (seen > rank) {
+                uint64_t upper = i == 0 ? 0 : (1ULL << i) - 1;
+                return upper < max ? upper : max;
+            }
+        }
+        return max;
+    }
+};
+
+class Histogram {
+public:
+    void record(uint64_t value) {
+        Shard &shard = _shards[(size_t)ThreadInfo::tid() % kShards];
+        shard.buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+        shard.count.fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(value, std::memory_order_relaxed);
+        uint64_t max = shard.max.load(std::memory_order_relaxed);
+        while (value > max &&
+               !shard.max.compare_exchange_weak(max, value,
+                                                std::memory_order_relaxed)) {
+        }
+    }
+
+    // 各项分别读取，并发记录时快照内部可能有轻微不一致
+    HistogramSnapshot snapshot() const {
+        HistogramSnapshot res;
+        for (const Shard &shard : _shards) {
+            res.count += shard.count.load(std::memory_order_relaxed);
+            res.sum += shard.sum.load(std::memory_order_relaxed);
+            uint64_t max = shard.max.load(std::memory_order_relaxed);
+            if (max > res.max) res.max = max;
+            for (size_t i = 0; i < HistogramSnapshot::kBuckets; i++)
+                res.buckets[i] +=
+                    shard.buckets[i].load(std::memory_order_relaxed);
+        }
+        return res;
+    }
+
+private:
+    static constexpr size_t kShards = 8;
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+        std::atomic<uint64_t> buckets[HistogramSnapshot::kBuckets] = {};
+    };
+
+    static size_t bucketOf(uint64_t value) {
+        if (value == 0) return 0;
+        size_t bucket = 64 - __builtin_clzll(value);
+        return bucket < HistogramSnapshot::kBuckets
+                   ? bucket
+                   : HistogramSnapshot::kBuckets - 1;
+    }
+
+    Shard _shards[kShards];
+};
+
+// 作用域计时：histogram为空时什么也不做
+class ScopedLatency {
+public:
+    explicit ScopedLatency(Histogram *histogram) : _histogram(histogram) {
+        if (_histogram) _start = std::chrono::steady_clock::now();
+    }
+    ~ScopedLatency() {
+        if (_histogram)
+            _histogram->record(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - _start)
+                    .count());
+    }
+
+private:
+    Histogram *_histogram;
+    std::chrono::steady_clock::time_point _start;
+};
+
+struct SinkMetricsSnapshot {
+    HistogramSnapshot write_ns;  // 每次log/logv的耗时
+    uint64_t bytes = 0;          // 累计写入字节数
+    double bytes_per_sec = 0;    // 开启统计以来的平均写入速度
+    // 带独立队列的落地方向(QueuedSink)：丢弃的批次和当前积压的批次，不依赖统计开关
+    uint64_t dropped_batches = 0;
+    uint64_t dropped_bytes = 0;
+    size_t pending_batches = 0;
+};
+
+// 日志器的统计快照，enabled为false时只有丢弃、积压和缓冲区数量有效
+struct MetricsSnapshot {
+    bool enabled = false;
+    double uptime_sec = 0;    // 开启统计以来的时间
+    size_t sample_every = 0;  // 采样统计项每多少次记录一次
+    HistogramSnapshot enqueue_ns;
+    HistogramSnapshot blocked_ns;
+    HistogramSnapshot fill_bytes;
+    HistogramSnapshot batch_bytes;
+    HistogramSnapshot format_ns;
+    std::vector<SinkMetricsSnapshot> sinks;  // 与日志器的落地方向一一对应
+    uint64_t dropped_msgs = 0;
+    uint64_t dropped_bytes = 0;
+    size_t inflight_buffers = 0;
+    size_t peak_inflight_buffers = 0;
+};
+
+// 一个日志器的全部统计项，工作器和日志器共同持有
+class PipelineMetrics {
+public:
+    using ptr = std::shared_ptr<PipelineMetrics>;
+
+    struct Sink {
+        Histogram write_ns;
+        std::atomic<uint64_t> bytes{0};
+    };
+
+    PipelineMetrics(size_t sink_count, size_t sample_every)
+        : _start(std::chrono::steady_clock::now()),
+          _sample_every(sample_every == 0 ? 1 : sample_every) {
+        for (size_t i = 0; i < sink_count; i++)
+            _sinks.emplace_back(new Sink());
+    }
+
+    Histogram enqueue_ns;
+    Histogram blocked_ns;
+    Histogram fill_bytes;
+    Histogram batch_bytes;
+    Histogram format_ns;
+
+    size_t sampleEvery() const { return _sample_every; }
+
+    // 落地方向的统计，index超出范围时返回nullptr
+    Sink *sink(size_t index) {
+        return index < _sinks.size() ? _sinks[index].get() : nullptr;
+    }
+
+    void snapshot(MetricsSnapshot &res) const {
+        res.enabled = true;
+        res.sample_every = _sample_every;
+        res.uptime_sec = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - _start)
+                             .count();
+        res.enqueue_ns = enqueue_ns.snapshot();
+        res.blocked_ns = blocked_ns.snapshot();
+        res.fill_bytes = fill_bytes.snapshot();
+        res.batch_bytes = batch_bytes.snapshot();
+        res.format_ns = format_ns.snapshot();
+        res.sinks.resize(_sinks.size());
+        for (size_t i = 0; i < _sinks.size(); i++) {
+            res.sinks[i].write_ns = _sinks[i]->write_ns.snapshot();
+            res.sinks[i].bytes =
+                _sinks[i]->bytes.load(std::memory_order_relaxed);
+            if (res.uptime_sec > 0)
+                res.sinks[i].bytes_per_sec =
+                    res.sinks[i].bytes / res.uptime_sec;
+        }
+    }
+
+private:
+    std::chrono::steady_clock::time_point _start;
+    size_t _sample_every;
+    std::vector<std::unique_ptr<Sink>> _sinks;
+};
+
+// 取统计对象中的某一项，统计未开启时返回nullptr，配合ScopedLatency使用
+inline Histogram *metricOf(PipelineMetrics *metrics,
+                           Histogram PipelineMetrics::*member) {
+    return metrics ? &(metrics->*member) : nullptr;
+}
+
+// 采样版本：每个线程对每个统计项单独计数，每sample_every次返回一次
+template <Histogram PipelineMetrics::*Member>
+inline Histogram *sampleOf(PipelineMetrics *metrics) {
+    if (!metrics) return nullptr;
+    static thread_local size_t count = 0;
+    if (++count < metrics->sampleEvery()) return nullptr;
+    count = 0;
+    return &(metrics->*Member);
+}
+}  // namespace wlog
@@ -0,0 +1,166 @@
+// 内存映射的落地方向
+//   1. 每个文件段用fallocate预先分配segment_size大小，再mmap映射
+//   2. 落地时直接拷贝到映射区，没有write系统调用
+//   3. 映射区写满时滚动到新文件，命名方式与RollSinkBySize相同；
+//      关闭文件段时截断到实际写入的长度
+//      新文件段以O_EXCL创建，文件名已存在(例如同一秒内重启，或多个落地方向
+//      使用同一基础文件名)时换下一个序号，不会截断已有的数据
+//   4. 数据拷贝进映射区后即位于页缓存中，进程崩溃也不会丢失；
+//      崩溃时文件末尾会残留预分配的'\0'，机器掉电仍需要msync/fdatasync
+//   5. 一批数据放不下时在最后一个换行处切分，单条日志不会跨文件
+//   6. 文件系统不支持fallocate时不映射(稀疏文件在磁盘写满时访问映射区会
+//      触发SIGBUS)，改为直接write，仍按segment_size滚动；预分配因其他原因
+//      失败(例如ENOSPC)时本次打开失败，计入errors()
+#pragma once
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "sink.hpp"
+#include "util.hpp"
+
+namespace wlog {
+#define DEFAULT_MMAP_SEGMENT_SIZE (64 * 1024 * 1024)
+
+class MmapSink : public LogSink {
+public:
+    using ptr = std::shared_ptr<MmapSink>;
+    MmapSink(const std::string &basename,
+             size_t segment_size = DEFAULT_MMAP_SEGMENT_SIZE)
+        : _filename(basename),
+          _segment_size(segment_size),
+          _fd(-1),
+          _base(nullptr),
+          _offset(0),
+          _errors(0) {
+        wlog::file::createDirectory(wlog::file::path(basename));
+    }
+    ~MmapSink() { closeSegment(); }
+
+    void log(const char *data, size_t len) override {
+        while (len > 0) {
+            if (_fd < 0 && !openSegment()) {
+                _errors.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            size_t room = _segment_size - _offset;
+            size_t n = len;
+            if (len > room) {
+                // 在放得下的最后一个换行处切分；一个换行都没有时，
+                // 文件段非空则先滚动，否则只能截断这条超长日志
+                n = cutPoint(data, room);
+                if (n == 0 && _offset > 0) {
+                    closeSegment();
+                    continue;
+                }
+                if (n == 0) n = room;
+            }
+            if (_base != nullptr) {
+                memcpy(_base + _offset, data, n);
+            } else if (!writeAll(data, n)) {
+                _errors.fetch_add(1, std::memory_order_relaxed);
+                closeSegment();
+                return;
+            }
+            _offset += n;
+            data += n;
+            len -= n;
+            if (_offset >= _segment_size || len > 0) closeSegment();
+        }
+    }
+
+    // 打开文件或映射失败的次数
+    uint64_t errors() const { return _errors.load(std::memory_order_relaxed); }
+
+private:
+    static size_t cutPoint(const char *data, size_t room) {
+        const char *p = (const char *)memrchr(data, '\n', room);
+        return p == nullptr ? 0 : p - data + 1;
+    }
+
+    bool openSegment() {
+        std::string name;
+        for (size_t i = 0; i < kMaxNameTries; i++) {
+            name = _filename.next();
+            _fd = ::open(name.c_str(),
+                         O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+            if (_fd >= 0 || errno != EEXIST) break;
+        }
+        if (_fd < 0) {
+            std::cerr << "打开日志文件失败: " << name << ": " << strerror(errno)
+                      << std::endl;
+            return false;
+        }
+        _offset = 0;
+        if (::fallocate(_fd, 0, 0, _segment_size) < 0) {
+            if (errno == EOPNOTSUPP || errno == ENOSYS) return true;
+            std::cerr << "预分配日志文件失败: " << name << ": "
+                      << strerror(errno) << std::endl;
+            discardSegment(name);
+            return false;
+        }
+        void *addr = ::mmap(nullptr, _segment_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, _fd, 0);
+        if (addr == MAP_FAILED) {
+            std::cerr << "映射日志文件失败: " << name << ": " << strerror(errno)
+                      << std::endl;
+            discardSegment(name);
+            return false;
+        }
+        ::madvise(addr, _segment_size, MADV_SEQUENTIAL);
+        _base = (char *)addr;
+        return true;
+    }
+
+    // 删除刚创建、还没有写入的文件段，避免每次重试留下空文件
+    void discardSegment(const std::string &name) {
+        ::close(_fd);
+        ::unlink(name.c_str());
+        _fd = -1;
+    }
+
+    // 不映射时直接写入，处理部分写入和EINTR
+    bool writeAll(const char *data, size_t len) {
+        while (len > 0) {
+            ssize_t ret = ::write(_fd, data, len);
+            if (ret < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += ret;
+            len -= (size_t)ret;
+        }
+        return true;
+    }
+
+    // 解除映射并截断到实际长度
+    void closeSegment() {
+        if (_fd < 0) return;
+        if (_base != nullptr) {
+            ::munmap(_base, _segment_size);
+            if (::ftruncate(_fd, _offset) < 0)
+                _errors.fetch_add(1, std::memory_order_relaxed);
+        }
+        ::close(_fd);
+        _fd = -1;
+        _base = nullptr;
+        _offset = 0;
+    }
+
+private:
+    static constexpr size_t kMaxNameTries = 1000;  // 文件名冲突时最多尝试的序号数
+
+    RollFilename _filename;
+    size_t _segment_size;  // 单个文件段的大小
+    int _fd;
+    char *_base;     // 映射区起始地址，不映射时为nullptr
+    size_t _offset;  // 当前文件段已写入的长度
+    std::atomic<uint64_t> _errors;
+};
+}  // namespace wlog
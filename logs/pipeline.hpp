@@ -0,0 +1,193 @@
+// 并行格式化流水线
+//   1. 工作器交出的每一批数据按提交顺序编号，放入待处理队列
+//   2. 多个格式化线程并行处理不同的批次
+//   3. 重排阶段按编号顺序写出，保证落地顺序与提交顺序完全一致；
+//      连续完成的多个批次用一次聚集写(iovec)交给落地方向
+//   4. 处理中的批次数量有上限，达到上限时提交方阻塞，由工作器的溢出策略反压生产者；
+//      待处理队列和已完成的批次都使用按上限分配的固定槽位，稳定运行时不再申请内存
+//   5. 已格式化的文本(例如丢弃统计)也可以按提交顺序插入，见submitFormatted
+#pragma once
+#include <sys/uio.h>
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer.hpp"
+
+namespace wlog {
+class OrderedPipeline {
+public:
+    using ptr = std::shared_ptr<OrderedPipeline>;
+    // 在格式化线程中并行调用，将一批输入转换为输出
+    using FormatFunc = std::function<void(Buffer &, std::string &)>;
+    // 在重排阶段按顺序调用，同一时刻只有一个线程调用
+    using WriteFunc = std::function<void(const struct iovec *, int)>;
+
+    OrderedPipeline(size_t thread_count, const FormatFunc &format,
+                    const WriteFunc &write)
+        : _format(format),
+          _write(write),
+          _running(true),
+          _writing(false),
+          _next_submit(0),
+          _next_write(0),
+          _inflight(0),
+          _pending_head(0),
+          _pending_count(0) {
+        if (thread_count == 0) thread_count = 1;
+        _max_inflight = thread_count * 2;
+        _pending.resize(_max_inflight);
+        _done.resize(_max_inflight);
+        for (size_t i = 0; i < thread_count; i++)
+            _threads.emplace_back(&OrderedPipeline::threadEntry, this);
+    }
+    ~OrderedPipeline() { stop(); }
+
+    // 取走buffer中的数据(交换，不拷贝)，buffer换回一个空的缓冲区
+    void submit(Buffer &buffer) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        std::unique_ptr<Batch> batch = acquire(lock);
+        batch->input.swap(buffer);
+        buffer.reset();
+        // 待处理的批次也计入_inflight，不会超过槽位数
+        _pending[(_pending_head + _pending_count++) % _max_inflight] =
+            std::move(batch);
+        _cond_work.notify_one();
+    }
+
+    // 已格式化的文本，不经过格式化线程，按提交顺序排在之前的批次之后写出；
+    // 取走text中的数据(交换)。停止之后调用时直接写出
+    void submitFormatted(std::string &text) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        std::unique_ptr<Batch> batch = acquire(lock);
+        batch->output.swap(text);
+        finish(std::move(batch), lock);
+    }
+
+    // 处理完所有已提交的批次后退出格式化线程
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_running) return;
+            _running = false;
+        }
+        _cond_work.notify_all();
+        for (auto &thread : _threads) {
+            if (thread.joinable()) thread.join();
+        }
+    }
+
+private:
+    struct Batch {
+        uint64_t seq;
+        Buffer input;
+        std::string output;
+    };
+
+    // 取一个空闲批次并编号(持有_mutex时调用)
+    std::unique_ptr<Batch> acquire(std::unique_lock<std::mutex> &lock) {
+        _cond_submit.wait(lock, [&]() { return _inflight < _max_inflight; });
+        std::unique_ptr<Batch> batch;
+        if (_free.empty()) {
+            batch.reset(new Batch());
+        } else {
+            batch = std::move(_free.back());
+            _free.pop_back();
+        }
+        batch->seq = _next_submit++;
+        _inflight++;
+        return batch;
+    }
+
+    // 处理中的批次不超过_max_inflight个，编号取模后不会冲突
+    std::unique_ptr<Batch> &slotOf(uint64_t seq) {
+        return _done[seq % _max_inflight];
+    }
+
+    // 放入已完成的槽位，并尝试按顺序写出
+    void finish(std::unique_ptr<Batch> batch,
+                std::unique_lock<std::mutex> &lock) {
+        slotOf(batch->seq) = std::move(batch);
+        writeReady(lock);
+    }
+
+    void threadEntry() {
+        while (true) {
+            std::unique_ptr<Batch> batch;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cond_work.wait(
+                    lock, [&]() { return !_running || _pending_count > 0; });
+                if (_pending_count == 0) break;
+                batch = std::move(_pending[_pending_head]);
+                _pending_head = (_pending_head + 1) % _max_inflight;
+                _pending_count--;
+            }
+            batch->output.clear();
+            _format(batch->input, batch->output);
+            batch->input.reset();
+            std::unique_lock<std::mutex> lock(_mutex);
+            finish(std::move(batch), lock);
+        }
+    }
+
+    // 重排阶段：取出编号连续的已完成批次一起写出；
+    // 已有线程在写出时直接返回，由该线程继续写出后续批次
+    void writeReady(std::unique_lock<std::mutex> &lock) {
+        if (_writing) return;
+        _writing = true;
+        while (slotOf(_next_write)) {
+            while (slotOf(_next_write)) {
+                _writing_batches.push_back(std::move(slotOf(_next_write)));
+                _next_write++;
+            }
+            lock.unlock();
+            _iov.clear();
+            for (auto &batch : _writing_batches) {
+                struct iovec iov;
+                iov.iov_base = &batch->output[0];
+                iov.iov_len = batch->output.size();
+                _iov.push_back(iov);
+            }
+            _write(_iov.data(), (int)_iov.size());
+            for (auto &batch : _writing_batches) {
+                if (batch->output.capacity() > DEFAULT_BUFFER_SIZE * 4)
+                    std::string().swap(batch->output);
+            }
+            lock.lock();
+            _inflight -= _writing_batches.size();
+            for (auto &batch : _writing_batches)
+                _free.push_back(std::move(batch));
+            _writing_batches.clear();
+            _cond_submit.notify_one();
+        }
+        _writing = false;
+    }
+
+private:
+    FormatFunc _format;
+    WriteFunc _write;
+    std::mutex _mutex;
+    std::condition_variable _cond_work;    // 格式化线程等待新批次
+    std::condition_variable _cond_submit;  // 提交方等待处理中的批次减少
+    bool _running;
+    bool _writing;          // 是否有线程正在写出
+    uint64_t _next_submit;  // 下一个提交批次的编号
+    uint64_t _next_write;   // 下一个应写出批次的编号
+    size_t _inflight;       // 已提交但尚未写出的批次数量
+    size_t _max_inflight;
+    std::vector<std::unique_ptr<Batch>> _pending;        // 等待格式化(环形队列)
+    size_t _pending_head;
+    size_t _pending_count;
+    std::vector<std::unique_ptr<Batch>> _done;           // 已格式化、等待写出(按编号取模)
+    std::vector<std::unique_ptr<Batch>> _free;           // 可复用的批次
+    std::vector<std::unique_ptr<Batch>> _writing_batches;  // 写出线程使用
+    std::vector<struct iovec> _iov;                        // 写出线程使用
+    std::vector<std::thread> _threads;
+};
+}  // namespace wlog
@@ -0,0 +1,78 @@
+// 调用点限流
+//   1. 每个调用点持有一个静态的限流状态，只用原子操作更新，不加锁
+//   2. 被抑制的调用只做一次原子加法，不求值参数、不格式化
+//   3. 下一条输出的日志带上suppressed字段，报告期间被抑制的条数
+// 用法见wlog.h中的WLOG_EVERY_N、WLOG_FIRST_N、WLOG_PER_SECOND
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+
+namespace wlog {
+// 每n次调用输出一次(第1、n+1、2n+1...次)
+class EveryNLimiter {
+public:
+    bool allow(uint64_t n, uint64_t &suppressed) {
+        uint64_t count = _count.fetch_add(1, std::memory_order_relaxed);
+        if (n <= 1) return true;
+        if (count % n != 0) return false;
+        suppressed = count == 0 ? 0 : n - 1;
+        return true;
+    }
+
+private:
+    std::atomic<uint64_t> _count{0};
+};
+
+// 只输出前n次，之后的调用全部抑制
+class FirstNLimiter {
+public:
+    bool allow(uint64_t n, uint64_t &suppressed) {
+        // 超过n之后只读不写，避免调用点所在的缓存行来回失效
+        if (_count.load(std::memory_order_relaxed) >= n) return false;
+        suppressed = 0;
+        return _count.fetch_add(1, std::memory_order_relaxed) < n;
+    }
+
+private:
+    std::atomic<uint64_t> _count{0};
+};
+
+// 令牌桶：每秒最多输出k次，允许k次的突发
+//   使用GCRA算法，用一个"理论到达时间"代替令牌数和上次补充时间，
+//   一次CAS即可完成判断和更新；时钟使用CLOCK_MONOTONIC_COARSE，只读vDSO
+class RateLimiter {
+public:
+    bool allow(uint64_t k, uint64_t &suppressed) {
+        if (k == 0) return false;
+        int64_t interval = kNsPerSec / (int64_t)k;
+        int64_t burst = kNsPerSec - interval;  // 允许提前的时间，对应k次突发
+        int64_t now = nowNs();
+        int64_t tat = _tat.load(std::memory_order_relaxed);
+        while (true) {
+            if (now < tat - burst) {
+                _suppressed.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            int64_t next = (tat > now ? tat : now) + interval;
+            if (_tat.compare_exchange_weak(tat, next,
+                                           std::memory_order_relaxed))
+                break;
+        }
+        suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    static constexpr int64_t kNsPerSec = 1000000000;
+
+    static int64_t nowNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return (int64_t)ts.tv_sec * kNsPerSec + ts.tv_nsec;
+    }
+
+    std::atomic<int64_t> _tat{0};  // 理论到达时间
+    std::atomic<uint64_t> _suppressed{0};
+};
+}  // namespace wlog
@@ -0,0 +1,447 @@
+// 每线程环形缓冲区的异步工作器
+//   1. 每个生产者线程拥有一个单生产者单消费者(SPSC)环形缓冲区，写入无锁
+//   2. 消费线程轮询所有环形缓冲区，批量拷贝到消费缓冲区后调用Func回调
+//   3. SAFE：环满时生产者等待；UNSAFE：环满时溢出到该线程的扩容区，不阻塞；
+//      其余溢出策略与AsyncLooper相同，但生产者无法从SPSC环中移除已提交的数据，
+//      DROP_OLDEST按DROP_NEWEST处理
+//   4. 使用共享线程池时，每次runBatch取空所有环作为一批
+//   5. 消费者按空闲策略等待；休眠时只有环中数据达到wake_bytes或环满才唤醒，
+//      否则最多等待flush_interval；未达到wake_bytes的写入不需要内存屏障
+//   注意：同一线程的日志保持顺序，不同线程之间的日志在批次内可能交错
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer.hpp"
+#include "looper.hpp"
+
+namespace wlog {
+class RingLooper : public Looper {
+public:
+    using ptr = std::shared_ptr<RingLooper>;
+
+private:
+    // 单个生产者线程的环形缓冲区
+    struct Ring {
+        Ring(size_t capacity)
+            : _capacity(roundUp(capacity)),
+              _mask(_capacity - 1),
+              _data(new char[_capacity]),
+              _spilling(false),
+              _owner_alive(true),
+              _closed(false),
+              _head(0),
+              _tail(0) {}
+
+        // 生产者：写入一条完整的消息，空间不足或处于溢出状态返回false
+        bool tryPush(const char* data, size_t len) {
+            if (_spilling.load(std::memory_order_acquire)) return false;
+            size_t tail = _tail.load(std::memory_order_relaxed);
+            size_t head = _head.load(std::memory_order_acquire);
+            if (_capacity - (tail - head) < len) return false;
+            size_t off = tail & _mask;
+            size_t first = std::min(len, _capacity - off);
+            memcpy(&_data[off], data, first);
+            memcpy(&_data[0], data + first, len - first);
+            _tail.store(tail + len, std::memory_order_release);
+            return true;
+        }
+
+        // 消费者：将环中已提交的数据拷贝到buffer
+        size_t drainRing(Buffer& buffer) {
+            size_t head = _head.load(std::memory_order_relaxed);
+            size_t tail = _tail.load(std::memory_order_acquire);
+            size_t len = tail - head;
+            if (len == 0) return 0;
+            size_t off = head & _mask;
+            size_t first = std::min(len, _capacity - off);
+            // 环绕的两段写入同一块连续空间，保证记录不被拆开
+            char* dst = buffer.reserve(len);
+            memcpy(dst, &_data[off], first);
+            memcpy(dst + first, &_data[0], len - first);
+            buffer.commit(len);
+            _head.store(tail, std::memory_order_release);
+            return len;
+        }
+
+        // 消费者：先取环中数据，再取溢出区数据，保证同一线程内的顺序
+        size_t drain(Buffer& buffer) {
+            size_t len = drainRing(buffer);
+            if (_spilling.load(std::memory_order_acquire)) {
+                std::lock_guard<std::mutex> lock(_spill_mutex);
+                // 进入溢出状态之前写入环中的数据一定排在溢出区之前
+                len += drainRing(buffer);
+                buffer.push(_spill.data(), _spill.size());
+                len += _spill.size();
+                _spill.clear();
+                _spilling.store(false, std::memory_order_release);
+            }
+            return len;
+        }
+
+        bool empty() {
+            return _head.load(std::memory_order_acquire) ==
+                       _tail.load(std::memory_order_acquire) &&
+                   !_spilling.load(std::memory_order_acquire);
+        }
+
+        // 环中待处理的字节数
+        size_t size() {
+            return _tail.load(std::memory_order_acquire) -
+                   _head.load(std::memory_order_acquire);
+        }
+
+        static size_t roundUp(size_t n) {
+            size_t cap = 64;
+            while (cap < n) cap <<= 1;
+            return cap;
+        }
+
+        const size_t _capacity;
+        const size_t _mask;
+        std::unique_ptr<char[]> _data;
+        std::mutex _spill_mutex;
+        std::string _spill;               // 溢出区(受_spill_mutex保护)
+        std::atomic<bool> _spilling;      // 溢出区非空，后续写入都进溢出区
+        std::atomic<bool> _owner_alive;   // 所属生产者线程是否存活
+        std::atomic<bool> _closed;        // 所属工作器是否已停止
+        alignas(64) std::atomic<size_t> _head;  // 消费位置(单调递增)
+        alignas(64) std::atomic<size_t> _tail;  // 生产位置(单调递增)
+    };
+
+    // 线程局部的环形缓冲区缓存，线程退出时标记环可被复用
+    struct RingCache {
+        struct Slot {
+            uint64_t looper_id;
+            std::shared_ptr<Ring> ring;
+        };
+        ~RingCache() {
+            for (auto& slot : slots)
+                slot.ring->_owner_alive.store(false, std::memory_order_release);
+        }
+        Ring* find(uint64_t looper_id) {
+            if (last != nullptr && last_id == looper_id) return last;
+            for (auto& slot : slots) {
+                if (slot.looper_id == looper_id) {
+                    last_id = looper_id;
+                    last = slot.ring.get();
+                    return last;
+                }
+            }
+            return nullptr;
+        }
+        void add(uint64_t looper_id, const std::shared_ptr<Ring>& ring) {
+            // 顺便清理已停止的工作器留下的环
+            for (size_t i = 0; i < slots.size();) {
+                if (slots[i].ring->_closed.load(std::memory_order_acquire)) {
+                    slots[i] = slots.back();
+                    slots.pop_back();
+                } else {
+                    i++;
+                }
+            }
+            slots.push_back({looper_id, ring});
+            last_id = looper_id;
+            last = ring.get();
+        }
+
+        std::vector<Slot> slots;
+        uint64_t last_id = 0;
+        Ring* last = nullptr;
+    };
+
+public:
+    RingLooper(const Func& cb, const LooperConfig& config = LooperConfig())
+        : _id(nextId()),
+          _running(true),
+          _stopping(false),
+          _sleeping(false),
+          _blocked(0),
+          _ring_gen(0),
+          _ring_size(config.ring_size),
+          _wake_bytes(std::max<size_t>(
+              1, std::min(config.wake_bytes,
+                          Ring::roundUp(config.ring_size) / 2))),
+          _con_gen(0),
+          _callback(cb),
+          _looper_type(config.type),
+          _config(config),
+          _executor(config.executor),
+          _metrics(config.metrics.get()),
+          _scheduled(false),
+          _closed(false) {
+        if (!_executor) _thread = std::thread(&RingLooper::threadEntry, this);
+    }
+    ~RingLooper() { stop(); }
+
+    void stop() override {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _running = false;
+            _stopping.store(true, std::memory_order_release);
+        }
+        _cond_con.notify_all();
+        _cond_pro.notify_all();
+        if (_thread.joinable()) _thread.join();
+        if (_executor) {
+            // 在当前线程取空所有环，之后线程池不再调用回调
+            std::lock_guard<std::mutex> run_lock(_run_mutex);
+            if (!_closed) {
+                do {
+                    drainOnce();
+                    refreshRings();
+                } while (anyPending());
+                _closed = true;
+            }
+        }
+        std::lock_guard<std::mutex> lock(_rings_mutex);
+        for (auto& ring : _rings)
+            ring->_closed.store(true, std::memory_order_release);
+    }
+
+    // 线程池调用：取空所有环处理一批数据，仍有数据时返回true
+    bool runBatch() override {
+        std::lock_guard<std::mutex> run_lock(_run_mutex);
+        if (_closed) return false;
+        drainOnce();
+        // 先撤销调度标志再检查，与wakeConsumer配合避免丢失唤醒
+        _scheduled.store(false, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        refreshRings();
+        return anyPending() && !_scheduled.exchange(true);
+    }
+
+    void push(const char* data, size_t len,
+              LogLevel::Value level = LogLevel::Value::OFF) override {
+        ScopedLatency timer(sampleOf<&PipelineMetrics::enqueue_ns>(_metrics));
+        Ring* ring = localRing();
+        // 1. 快速路径：环中有空间且未处于溢出状态，无锁写入
+        if (ring->tryPush(data, len)) {
+            wakeConsumer(ring->size());
+            return;
+        }
+        // 2. 环满时按溢出策略处理；UNSAFE以及单条超过环容量的消息写入溢出区
+        if (len <= ring->_capacity) {
+            switch (_looper_type) {
+                case LooperType::UNSAFE:
+                    break;
+                case LooperType::DROP_NEWEST:
+                case LooperType::DROP_OLDEST:
+                    recordDrop(len);
+                    return;
+                case LooperType::BLOCK_TIMEOUT:
+                    if (!waitForSpace(ring, data, len,
+                                      std::chrono::steady_clock::now() +
+                                          _config.block_timeout))
+                        recordDrop(len);
+                    return;
+                case LooperType::DROP_BELOW_LEVEL:
+                    if (level < _config.keep_level) {
+                        recordDrop(len);
+                        return;
+                    }
+                    if (waitForSpace(ring, data, len)) return;
+                    break;
+                case LooperType::SAFE:
+                default:
+                    if (waitForSpace(ring, data, len)) return;
+                    break;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(ring->_spill_mutex);
+            ring->_spill.append(data, len);
+            ring->_spilling.store(true, std::memory_order_release);
+        }
+        wakeConsumer(0, true);
+    }
+
+private:
+    static uint64_t nextId() {
+        static std::atomic<uint64_t> id(0);
+        return ++id;
+    }
+
+    static RingCache& ringCache() {
+        static thread_local RingCache cache;
+        return cache;
+    }
+
+    Ring* localRing() {
+        RingCache& cache = ringCache();
+        Ring* ring = cache.find(_id);
+        if (ring != nullptr) return ring;
+        std::shared_ptr<Ring> fresh;
+        {
+            std::lock_guard<std::mutex> lock(_rings_mutex);
+            // 优先复用已退出线程留下的空环
+            for (auto& r : _rings) {
+                if (!r->_owner_alive.load(std::memory_order_acquire) &&
+                    r->empty()) {
+                    r->_owner_alive.store(true, std::memory_order_release);
+                    fresh = r;
+                    break;
+                }
+            }
+            if (!fresh) {
+                fresh = std::make_shared<Ring>(_ring_size);
+                _rings.push_back(fresh);
+                _ring_gen.fetch_add(1, std::memory_order_release);
+            }
+        }
+        cache.add(_id, fresh);
+        return fresh.get();
+    }
+
+    // 等待消费者腾出空间，成功写入返回true；超时或工作器停止时返回false
+    bool waitForSpace(Ring* ring, const char* data, size_t len,
+                      std::chrono::steady_clock::time_point deadline =
+                          std::chrono::steady_clock::time_point::max()) {
+        for (int spin = 0; spin < 64; spin++) {
+            wakeConsumer(0, true);
+            std::this_thread::yield();
+            if (ring->tryPush(data, len)) return true;
+        }
+        _blocked.fetch_add(1);
+        ScopedLatency blocked(metricOf(_metrics, &PipelineMetrics::blocked_ns));
+        bool ok = false;
+        while (true) {
+            wakeConsumer(0, true);
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (!_running || std::chrono::steady_clock::now() >= deadline)
+                break;
+            _cond_pro.wait_for(lock, std::chrono::milliseconds(1));
+            lock.unlock();
+            if (ring->tryPush(data, len)) {
+                ok = true;
+                break;
+            }
+        }
+        _blocked.fetch_sub(1);
+        if (ok) wakeConsumer(ring->size());
+        return ok;
+    }
+
+    // 只有消费者进入休眠且本线程的环达到唤醒阈值时才需要加锁唤醒；
+    // 低于阈值的数据由消费者按flush_interval定时取走，快速路径不需要屏障；
+    // 达到阈值或强制唤醒时才用全屏障与消费者声明休眠配对，避免丢失唤醒。
+    // 使用线程池时没有定时处理，每次都需要屏障，只有未在就绪队列中才提交
+    void wakeConsumer(size_t pending, bool force = false) {
+        if (_executor) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!_scheduled.load(std::memory_order_relaxed) &&
+                !_scheduled.exchange(true))
+                _executor->schedule(weak_from_this());
+            return;
+        }
+        if (!force && pending < _wake_bytes) return;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (force || _sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _cond_con.notify_one();
+        }
+    }
+
+    bool anyPending() {
+        for (auto& ring : _con_rings)
+            if (!ring->empty()) return true;
+        return false;
+    }
+
+    // 所有环中待处理的数据达到唤醒阈值，或有环处于溢出状态
+    bool wakeReady() {
+        refreshRings();
+        size_t pending = 0;
+        for (auto& ring : _con_rings) {
+            if (ring->_spilling.load(std::memory_order_acquire)) return true;
+            pending += ring->size();
+        }
+        return pending >= _wake_bytes;
+    }
+
+    void refreshRings() {
+        size_t cur = _ring_gen.load(std::memory_order_acquire);
+        if (cur == _con_gen) return;
+        std::lock_guard<std::mutex> lock(_rings_mutex);
+        _con_rings = _rings;
+        _con_gen = _ring_gen.load(std::memory_order_relaxed);
+    }
+
+    // 取空所有环并处理，返回是否处理了数据
+    bool drainOnce() {
+        refreshRings();
+        for (auto& ring : _con_rings) {
+            size_t len = ring->drain(_con_buffer);
+            if (_metrics && len > 0) _metrics->fill_bytes.record(len);
+        }
+        if (_con_buffer.empty()) return false;
+        if (_metrics) _metrics->batch_bytes.record(_con_buffer.readableSize());
+        _callback(_con_buffer);
+        _con_buffer.reset();
+        if (_blocked.load(std::memory_order_relaxed) > 0) _cond_pro.notify_all();
+        return true;
+    }
+
+    void threadEntry() {
+        while (1) {
+            // 等待数据达到唤醒阈值，最多等待flush_interval
+            auto deadline =
+                std::chrono::steady_clock::now() + _config.flush_interval;
+            auto ready = [&]() {
+                return _stopping.load(std::memory_order_acquire) || wakeReady();
+            };
+            if (!idleSpin(_config, deadline, ready)) {
+                std::unique_lock<std::mutex> lock(_mutex);
+                // 先声明即将休眠，再检查一次是否有数据，避免丢失唤醒
+                _sleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (_running && !wakeReady())
+                    _cond_con.wait_until(lock, deadline);
+                _sleeping.store(false, std::memory_order_relaxed);
+            }
+            drainOnce();
+            // 运行标志设为否且数据处理完毕，再退出
+            if (_stopping.load(std::memory_order_acquire)) {
+                refreshRings();
+                if (!anyPending()) break;
+            }
+        }
+    }
+
+private:
+    const uint64_t _id;  // 工作器唯一标识，用于线程局部缓存查找
+    bool _running;       // 工作停止标志(受_mutex保护)
+    std::atomic<bool> _stopping;     // 与_running相同，供消费者自旋时无锁读取
+    std::atomic<bool> _sleeping;     // 消费者是否处于休眠
+    std::atomic<int> _blocked;       // 正在等待空间的生产者数量
+    std::atomic<size_t> _ring_gen;   // 环列表版本号
+    size_t _ring_size;
+    size_t _wake_bytes;  // 唤醒消费者的字节阈值(至少1，不超过环容量的一半)
+    std::mutex _rings_mutex;
+    std::vector<std::shared_ptr<Ring>> _rings;  // 所有生产者的环
+    std::vector<std::shared_ptr<Ring>> _con_rings;  // 消费者的本地快照
+    size_t _con_gen;                                // 快照对应的版本号
+    Buffer _con_buffer;                             // 消费缓冲区
+    std::mutex _mutex;
+    std::condition_variable _cond_pro;  // 生产者条件变量
+    std::condition_variable _cond_con;  // 消费者条件变量
+    Func _callback;
+    LooperType _looper_type;
+    LooperConfig _config;
+    LooperExecutor::ptr _executor;  // 共享线程池，为空时使用独立的消费线程
+    PipelineMetrics* _metrics;      // 统计(由_config持有)，为空时不记录
+    std::atomic<bool> _scheduled;   // 是否已提交到线程池
+    std::mutex _run_mutex;  // 保证同一时刻只有一个线程处理本工作器的数据
+    bool _closed;           // 已停止，线程池不再调用回调(受_run_mutex保护)
+    std::thread _thread;    // 独立的消费线程
+};
+}  // namespace wlog
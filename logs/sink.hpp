@@ -2,21 +2,48 @@
 //   1. 抽象出落地基类
 //   2. 实现不同子类
 //   3. 用简单工厂进行创建与表示的分离
+//   4. 每个落地方向可以有自己的最低等级和格式，需要在构造日志器之前设置
 #pragma once
+#include <sys/uio.h>
+
 #include <cassert>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <sstream>
 
+#include "compress.hpp"
+#include "format.hpp"
+#include "level.hpp"
 #include "util.hpp"
 
 namespace wlog {
 class LogSink {
 public:
     using ptr = std::shared_ptr<LogSink>;
-    ~LogSink() {}
+    virtual ~LogSink() {}
     virtual void log(const char *data, size_t len) = 0;
+    // 一次写入多段数据，默认逐段调用log；支持聚集写的落地方向可以重写
+    virtual void logv(const struct iovec *iov, int iovcnt) {
+        for (int i = 0; i < iovcnt; i++)
+            log((const char *)iov[i].iov_base, iov[i].iov_len);
+    }
+
+    // 低于该等级的日志不写入本落地方向
+    void setLevel(LogLevel::Value level) { _level = level; }
+    LogLevel::Value level() const { return _level; }
+    // 本落地方向使用的格式，为空时使用日志器的格式
+    void setFormatter(const Formatter::ptr &formatter) {
+        _formatter = formatter;
+    }
+    void setPattern(const std::string &pattern) {
+        _formatter = std::make_shared<Formatter>(pattern);
+    }
+    const Formatter::ptr &formatter() const { return _formatter; }
+
+private:
+    LogLevel::Value _level = LogLevel::Value::DEBUG;
+    Formatter::ptr _formatter;
 };
 
 // 落地方向：标准输出
@@ -53,18 +80,51 @@ private:
     std::ofstream _ofs;
 };
 
+// 滚动文件的命名：基础文件名 + 创建时间 + "-" + 序号 + ".log"
+class RollFilename {
+public:
+    RollFilename(const std::string &basename)
+        : _basename(basename), _name_count(0) {}
+
+    // 生成下一个文件名
+    std::string next() {
+        time_t time = date::now();
+        struct tm t;
+        localtime_r(&time, &t);
+        std::stringstream ss;
+        ss << _basename;
+        ss << t.tm_year + 1900;
+        ss << t.tm_mon;
+        ss << t.tm_mday;
+        ss << t.tm_hour;
+        ss << t.tm_min;
+        ss << t.tm_sec;
+        ss << "-";
+        ss << _name_count++;
+        ss << ".log";
+        return ss.str();
+    }
+
+private:
+    std::string _basename;  // 基础文件名
+    size_t _name_count;
+};
+
 // 落地方向：按照指定文件大小滚动文件
 class RollSinkBySize : public LogSink {
 public:
     using ptr = std::shared_ptr<RollSinkBySize>;
-    // 传入文件名，和单个文件的上限，构造输出流
-    RollSinkBySize(const std::string &basename, size_t max_size)
+    // 传入文件名，和单个文件的上限，构造输出流；
+    // compress_closed为true时，滚动关闭的文件在后台线程中压缩为"文件名.wlz"
+    RollSinkBySize(const std::string &basename, size_t max_size,
+                   bool compress_closed = false)
         : _basename(basename),
+          _filename(basename),
           _max_size(max_size),
-          _cur_size(0),
-          _name_count(0) {
+          _cur_size(0) {
         // 创建指定目录
         wlog::file::createDirectory(wlog::file::path(_basename));
+        if (compress_closed) _compressor.reset(new BackgroundCompressor());
     }
     // 将日志消息写到指定文件
     void log(const char *data, size_t len) {
@@ -77,39 +137,25 @@ public:
 private:
     void initLogFile() {
         if (_ofs.is_open() == false || _cur_size >= _max_size) {
-            _ofs.close();
-            std::string name = createFilename();
-            _ofs.open(name, std::ios::binary | std::ios::app);
+            if (_ofs.is_open()) {
+                _ofs.close();
+                if (_compressor) _compressor->add(_cur_name);
+            }
+            _cur_name = _filename.next();
+            _ofs.open(_cur_name, std::ios::binary | std::ios::app);
             assert(_ofs.is_open());
             _cur_size = 0;
         }
     }
 
-    // 创建文件
-    std::string createFilename() {
-        time_t time = date::now();
-        struct tm t;
-        localtime_r(&time, &t);
-        std::stringstream ss;
-        ss << _basename;
-        ss << t.tm_year + 1900;
-        ss << t.tm_mon;
-        ss << t.tm_mday;
-        ss << t.tm_hour;
-        ss << t.tm_min;
-        ss << t.tm_sec;
-        ss << "-";
-        ss << _name_count++;
-        ss << ".log";
-        return ss.str();
-    }
-
 private:
     std::string _basename;  // 基础文件名
+    RollFilename _filename;
+    std::string _cur_name;  // 当前文件名
     std::ofstream _ofs;
     size_t _max_size;  // 单个文件的大小上限
     size_t _cur_size;  // 当前文件大小
-    size_t _name_count;
+    std::unique_ptr<BackgroundCompressor> _compressor;  // 压缩已关闭的文件
 };
 
 class SinkFactory {
@@ -0,0 +1,302 @@
+// 落地方向的独立队列
+//   1. QueuedSink包装一个落地方向，持有自己的批次队列和写线程；
+//      落地较慢(例如管道另一端阻塞的标准输出)只会积压自己的队列，
+//      不影响同一日志器的其他落地方向
+//   2. 异步日志器把每批数据包装为引用计数的SinkBatch，同一批次交给所有队列，
+//      不拷贝：未格式化的路径直接接管工作器的缓冲区，延迟格式化的路径交换格式化结果
+//   3. 批次在所有队列都写出后回到SinkBatchPool复用，稳定运行时不再申请内存
+//   4. 队列满时按自己的溢出策略处理，见SinkQueueConfig
+//   5. 写线程一次取走队列中的全部批次，用一次logv聚集写入
+#pragma once
+#include <sys/uio.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer.hpp"
+#include "looper.hpp"
+#include "metrics.hpp"
+#include "sink.hpp"
+
+namespace wlog {
+#define DEFAULT_SINK_QUEUE_BATCHES 16  // 每个落地队列默认最多积压的批次数
+
+// 一批待写出的数据，由日志器和各个落地队列共同引用
+struct SinkBatch {
+    using ptr = std::shared_ptr<SinkBatch>;
+
+    Buffer buffer;                  // 接管的工作器缓冲区
+    std::string text;               // 格式化结果或拷贝的数据
+    std::vector<struct iovec> iov;  // 指向buffer或text中的可读区域
+    size_t bytes = 0;
+
+    // 数据在buffer中
+    void fromBuffer() {
+        buffer.readv(iov);
+        bytes = buffer.readableSize();
+    }
+    // 数据在text中
+    void fromText() {
+        iov.resize(1);
+        iov[0].iov_base = &text[0];
+        iov[0].iov_len = text.size();
+        bytes = text.size();
+    }
+    // 拷贝到text中，只在无法接管数据时使用
+    void copy(const struct iovec *src, int count) {
+        for (int i = 0; i < count; i++)
+            text.append((const char *)src[i].iov_base, src[i].iov_len);
+        fromText();
+    }
+
+    void clear() {
+        buffer.reset();
+        text.clear();
+        if (text.capacity() > DEFAULT_BUFFER_SIZE * 4) std::string().swap(text);
+        iov.clear();
+        bytes = 0;
+    }
+};
+
+// 批次池：没有被任何队列引用的批次可以复用
+class SinkBatchPool {
+public:
+    // 返回一个已清空的批次，都在使用中时新建一个
+    SinkBatch::ptr acquire() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        SinkBatch::ptr res;
+        size_t idle = 0;
+        for (size_t i = 0; i < _batches.size();) {
+            if (_batches[i].use_count() != 1) {
+                i++;
+                continue;
+            }
+            if (!res) {
+                res = _batches[i++];
+                continue;
+            }
+            // 突发过后多余的空闲批次释放掉
+            if (++idle > kKeepIdle) {
+                _batches[i] = std::move(_batches.back());
+                _batches.pop_back();
+                continue;
+            }
+            i++;
+        }
+        if (res) {
+            // 与队列释放引用时的release配对，之后可以安全地改写批次
+            std::atomic_thread_fence(std::memory_order_acquire);
+            res->clear();
+            return res;
+        }
+        _batches.push_back(std::make_shared<SinkBatch>());
+        return _batches.back();
+    }
+
+private:
+    static constexpr size_t kKeepIdle = 2;
+
+    std::mutex _mutex;
+    std::vector<SinkBatch::ptr> _batches;
+};
+
+// 队列配置
+//   type: 队列满时的处理策略，沿用工作器的LooperType：
+//       SAFE阻塞直到有空间(会反压日志器的工作线程)，BLOCK_TIMEOUT最多阻塞
+//       block_timeout，DROP_NEWEST丢弃新批次，DROP_OLDEST丢弃队列中最早的批次，
+//       UNSAFE不限长度；DROP_BELOW_LEVEL对批次没有意义，按SAFE处理
+//   max_batches: 最多积压的批次数
+struct SinkQueueConfig {
+    SinkQueueConfig(LooperType queue_type = LooperType::SAFE)
+        : type(queue_type),
+          max_batches(DEFAULT_SINK_QUEUE_BATCHES),
+          block_timeout(10) {}
+
+    LooperType type;
+    size_t max_batches;
+    std::chrono::milliseconds block_timeout;
+};
+
+class QueuedSink : public LogSink {
+public:
+    using ptr = std::shared_ptr<QueuedSink>;
+    QueuedSink(const LogSink::ptr &sink,
+               const SinkQueueConfig &config = SinkQueueConfig())
+        : _sink(sink),
+          _config(config),
+          _running(true),
+          _busy(false),
+          _stat(nullptr),
+          _dropped_batches(0),
+          _dropped_bytes(0) {
+        if (_config.max_batches == 0) _config.max_batches = 1;
+        // 等级和格式沿用被包装的落地方向
+        setLevel(_sink->level());
+        setFormatter(_sink->formatter());
+        _thread = std::thread(&QueuedSink::threadEntry, this);
+    }
+    ~QueuedSink() { stop(); }
+
+    // 直接调用(例如同步日志器)时数据需要拷贝一次
+    void log(const char *data, size_t len) override {
+        struct iovec iov;
+        iov.iov_base = const_cast<char *>(data);
+        iov.iov_len = len;
+        logv(&iov, 1);
+    }
+    void logv(const struct iovec *iov, int iovcnt) override {
+        SinkBatch::ptr batch = _pool.acquire();
+        batch->copy(iov, iovcnt);
+        push(batch);
+    }
+
+    // 放入队列，不拷贝；停止之后在调用线程中直接写出
+    void push(const SinkBatch::ptr &batch) {
+        if (batch->bytes == 0) return;
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_running && _queue.size() >= _config.max_batches) {
+            auto room = [&]() {
+                return !_running || _queue.size() < _config.max_batches;
+            };
+            switch (_config.type) {
+                case LooperType::UNSAFE:
+                    break;
+                case LooperType::DROP_NEWEST:
+                    recordDrop(*batch);
+                    return;
+                case LooperType::DROP_OLDEST:
+                    recordDrop(*_queue.front());
+                    _queue.pop_front();
+                    break;
+                case LooperType::BLOCK_TIMEOUT:
+                    if (!_cond_pro.wait_for(lock, _config.block_timeout,
+                                            room)) {
+                        recordDrop(*batch);
+                        return;
+                    }
+                    break;
+                default:
+                    _cond_pro.wait(lock, room);
+                    break;
+            }
+        }
+        if (!_running) {
+            PipelineMetrics::Sink *stat = _stat;
+            lock.unlock();
+            write(&batch, 1, stat);
+            return;
+        }
+        _queue.push_back(batch);
+        _cond_con.notify_one();
+    }
+
+    // 等待已入队的批次全部写出
+    void flush() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cond_idle.wait(lock, [&]() { return _queue.empty() && !_busy; });
+    }
+
+    // 写出剩余批次后退出写线程
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_running) return;
+            _running = false;
+        }
+        _cond_con.notify_all();
+        _cond_pro.notify_all();
+        if (_thread.joinable()) _thread.join();
+    }
+
+    // 写线程记录写入耗时和字节数，由日志器在开启统计时设置
+    void attachMetrics(PipelineMetrics::Sink *stat) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stat = stat;
+    }
+
+    const LogSink::ptr &sink() const { return _sink; }
+
+    // 因溢出策略丢弃的批次数和字节数，以及当前积压的批次数
+    uint64_t droppedBatches() const {
+        return _dropped_batches.load(std::memory_order_relaxed);
+    }
+    uint64_t droppedBytes() const {
+        return _dropped_bytes.load(std::memory_order_relaxed);
+    }
+    size_t pendingBatches() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _queue.size();
+    }
+
+private:
+    void recordDrop(const SinkBatch &batch) {
+        _dropped_batches.fetch_add(1, std::memory_order_relaxed);
+        _dropped_bytes.fetch_add(batch.bytes, std::memory_order_relaxed);
+    }
+
+    // 多个批次拼成一次聚集写；写线程与停止后的直接写出可能并发，需要加锁
+    void write(const SinkBatch::ptr *batches, size_t count,
+               PipelineMetrics::Sink *stat) {
+        std::lock_guard<std::mutex> lock(_write_mutex);
+        _iov.clear();
+        size_t bytes = 0;
+        for (size_t i = 0; i < count; i++) {
+            _iov.insert(_iov.end(), batches[i]->iov.begin(),
+                        batches[i]->iov.end());
+            bytes += batches[i]->bytes;
+        }
+        {
+            ScopedLatency timer(stat ? &stat->write_ns : nullptr);
+            _sink->logv(_iov.data(), (int)_iov.size());
+        }
+        if (stat) stat->bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void threadEntry() {
+        std::vector<SinkBatch::ptr> writing;
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _cond_con.wait(lock,
+                           [&]() { return !_running || !_queue.empty(); });
+            if (_queue.empty()) break;
+            for (auto &batch : _queue) writing.push_back(std::move(batch));
+            _queue.clear();
+            _busy = true;
+            PipelineMetrics::Sink *stat = _stat;
+            lock.unlock();
+            _cond_pro.notify_all();
+            write(writing.data(), writing.size(), stat);
+            // 释放引用，批次回到日志器的批次池
+            writing.clear();
+            lock.lock();
+            _busy = false;
+            _cond_idle.notify_all();
+        }
+    }
+
+private:
+    LogSink::ptr _sink;
+    SinkQueueConfig _config;
+    std::mutex _mutex;
+    std::condition_variable _cond_pro;   // 推入方等待队列腾出空间
+    std::condition_variable _cond_con;   // 写线程等待新批次
+    std::condition_variable _cond_idle;  // flush等待队列写空
+    std::deque<SinkBatch::ptr> _queue;   // 待写出的批次(受_mutex保护)
+    bool _running;                       // 受_mutex保护
+    bool _busy;                          // 写线程正在写出(受_mutex保护)
+    PipelineMetrics::Sink *_stat;        // 受_mutex保护
+    std::mutex _write_mutex;             // 保护_sink和_iov
+    std::vector<struct iovec> _iov;
+    SinkBatchPool _pool;  // 直接调用log/logv时使用
+    std::atomic<uint64_t> _dropped_batches;
+    std::atomic<uint64_t> _dropped_bytes;
+    std::thread _thread;
+};
+}  // namespace wlog
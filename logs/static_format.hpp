@@ -0,0 +1,386 @@
+// 编译期格式化器
+//   1. 格式化字符串在编译期解析为子项数组，格式错误直接编译失败
+//   2. 每个子项在编译期展开为直线代码：无虚函数调用、无shared_ptr、无ostream
+//   3. 格式化字符串需要具有静态存储期，例如：
+//        inline constexpr char kPattern[] = "[%p]%m%n";
+//        wlog::StaticFormatter<kPattern>::format(out, msg);
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "fields.hpp"
+#include "level.hpp"
+#include "message.hpp"
+#include "threadinfo.hpp"
+
+namespace wlog {
+// 默认格式
+inline constexpr char DEFAULT_PATTERN[] =
+    "[%d{%H:%M:%S}][%t][%c][%p][%f:%l]%T%m%n";
+
+// 线程ID的字符串形式，每个线程按ID直接映射缓存渲染结果，
+// 格式化线程交替处理多个生产者时也不需要重新渲染
+inline void appendThreadId(std::string &out, std::thread::id tid) {
+    struct Cache {
+        std::thread::id id;
+        char str[32];
+        size_t len = 0;
+    };
+    static constexpr size_t kSlots = 16;
+    static thread_local Cache caches[kSlots];
+    Cache &cache = caches[std::hash<std::thread::id>()(tid) % kSlots];
+    if (cache.len == 0 || cache.id != tid) {
+        std::ostringstream ss;
+        ss << tid;
+        std::string s = ss.str();
+        cache.len = std::min(s.size(), sizeof(cache.str));
+        memcpy(cache.str, s.data(), cache.len);
+        cache.id = tid;
+    }
+    out.append(cache.str, cache.len);
+}
+
+// 整数直接转换为十进制追加到out
+template <typename T>
+inline void appendInteger(std::string &out, T value) {
+    char tmp[24];
+    auto res = std::to_chars(tmp, tmp + sizeof(tmp), value);
+    out.append(tmp, res.ptr - tmp);
+}
+
+// 时间渲染：
+//   1. 在strftime格式的基础上增加%ms/%us/%ns，分别输出3/6/9位秒内小数
+//   2. strftime的结果按线程缓存，秒数不变时只追加秒内小数部分
+class TimeRenderer {
+public:
+    TimeRenderer(std::string_view fmt) : _id(nextId()) {
+        // 按秒内小数说明符切分，其余部分原样交给strftime
+        std::string piece;
+        size_t pos = 0;
+        while (pos < fmt.size()) {
+            if (fmt[pos] == '%' && pos + 1 < fmt.size() && fmt[pos + 1] == '%') {
+                piece.append("%%");
+                pos += 2;
+                continue;
+            }
+            int digits = 0;
+            if (fmt.compare(pos, 3, "%ms") == 0) digits = 3;
+            if (fmt.compare(pos, 3, "%us") == 0) digits = 6;
+            if (fmt.compare(pos, 3, "%ns") == 0) digits = 9;
+            if (digits != 0 && _pieces.size() + 1 < kMaxPieces) {
+                _pieces.push_back({piece, digits});
+                piece.clear();
+                pos += 3;
+                continue;
+            }
+            piece.push_back(fmt[pos]);
+            pos++;
+        }
+        _pieces.push_back({piece, 0});
+    }
+
+    void format(std::string &out, time_t sec, uint32_t nsec) const {
+        Cache &cache = cacheFor(_id);
+        if (cache.owner != _id || cache.sec != sec) render(cache, sec);
+        size_t begin = 0;
+        for (size_t i = 0; i < _pieces.size(); i++) {
+            out.append(cache.text + begin, cache.ends[i] - begin);
+            begin = cache.ends[i];
+            if (_pieces[i].digits != 0) appendFraction(out, nsec, _pieces[i].digits);
+        }
+    }
+
+private:
+    static constexpr size_t kMaxPieces = 8;
+    static constexpr size_t kCacheSlots = 8;
+
+    struct Piece {
+        std::string fmt;  // strftime格式
+        int digits;       // 之后紧跟的秒内小数位数，0表示没有
+    };
+    // 每个线程的直接映射缓存，按渲染器编号选择槽位
+    struct Cache {
+        uint64_t owner = 0;
+        time_t sec = 0;
+        char text[128];
+        uint16_t ends[kMaxPieces];  // 每段strftime结果在text中的结束位置
+    };
+
+    static uint64_t nextId() {
+        static std::atomic<uint64_t> id(0);
+        return ++id;
+    }
+    static Cache &cacheFor(uint64_t id) {
+        static thread_local Cache caches[kCacheSlots];
+        return caches[id % kCacheSlots];
+    }
+
+    void render(Cache &cache, time_t sec) const {
+        struct tm t;
+        localtime_r(&sec, &t);
+        size_t len = 0;
+        for (size_t i = 0; i < _pieces.size(); i++) {
+            if (!_pieces[i].fmt.empty() && len < sizeof(cache.text))
+                len += strftime(cache.text + len, sizeof(cache.text) - len,
+                                _pieces[i].fmt.c_str(), &t);
+            cache.ends[i] = (uint16_t)len;
+        }
+        cache.owner = _id;
+        cache.sec = sec;
+    }
+
+    static void appendFraction(std::string &out, uint32_t nsec, int digits) {
+        uint32_t value = nsec;
+        for (int i = digits; i < 9; i++) value /= 10;
+        char tmp[9];
+        for (int i = digits - 1; i >= 0; i--) {
+            tmp[i] = '0' + value % 10;
+            value /= 10;
+        }
+        out.append(tmp, digits);
+    }
+
+    uint64_t _id;  // 唯一编号，用于定位线程缓存
+    std::vector<Piece> _pieces;
+};
+
+// 编译期解析得到的子项
+//   kind: 子项类型，与Formatter中的格式字符一一对应，TEXT表示普通字符串
+//   pos/len: TEXT为原样输出的文本，TIME为{}中的时间格式，
+//            FIELDS为{}中的字段格式，THREAD为{}中的线程ID格式
+struct StaticItem {
+    enum class Kind {
+        TEXT,
+        TIME,
+        THREAD,
+        THREAD_NAME,
+        LOGGER,
+        LEVEL,
+        FILE,
+        LINE,
+        TAB,
+        NLINE,
+        MSG,
+        FIELDS
+    };
+    Kind kind = Kind::TEXT;
+    size_t pos = 0;
+    size_t len = 0;
+};
+
+template <size_t N>
+struct StaticItems {
+    StaticItem items[N > 0 ? N : 1];
+    size_t size = 0;
+};
+
+// {}中的内容[val, val + len)是否等于str
+constexpr bool staticEquals(const char *val, size_t len, const char *str) {
+    size_t i = 0;
+    for (; i < len && str[i] != '\0'; i++)
+        if (val[i] != str[i]) return false;
+    return i == len && str[i] == '\0';
+}
+
+// %k{}中的字段格式：空或logfmt为LOGFMT，json为JSON
+constexpr FieldCodec::Style staticFieldStyle(const char *val, size_t len) {
+    if (len == 0 || staticEquals(val, len, "logfmt"))
+        return FieldCodec::Style::LOGFMT;
+    if (staticEquals(val, len, "json")) return FieldCodec::Style::JSON;
+    throw "没有对应的字段格式";
+}
+
+// %t{}中的线程ID格式：空为std::thread::id，tid为内核线程ID
+constexpr bool staticKernelTid(const char *val, size_t len) {
+    if (len == 0) return false;
+    if (staticEquals(val, len, "tid")) return true;
+    throw "没有对应的线程ID格式";
+}
+
+// 编译期解析，规则与Formatter::parsePattern一致；
+// 格式错误时抛出异常，在常量表达式中即为编译错误
+constexpr size_t parseStaticPattern(const char *pattern, StaticItem *items) {
+    size_t count = 0;
+    size_t pos = 0;
+    size_t text_begin = 0;
+    auto flushText = [&](size_t end) {
+        if (end > text_begin) {
+            if (items) items[count] = {StaticItem::Kind::TEXT, text_begin,
+                                       end - text_begin};
+            count++;
+        }
+    };
+    while (pattern[pos] != '\0') {
+        if (pattern[pos] != '%') {
+            pos++;
+            continue;
+        }
+        flushText(pos);
+        pos++;
+        if (pattern[pos] == '\0') throw "%之后没有字符, 格式错误";
+        if (pattern[pos] == '%') {
+            // %% 输出一个%，文本从第二个%开始
+            text_begin = pos;
+            pos++;
+            continue;
+        }
+        StaticItem item;
+        switch (pattern[pos]) {
+            case 'd':
+                item.kind = StaticItem::Kind::TIME;
+                break;
+            case 't':
+                item.kind = StaticItem::Kind::THREAD;
+                break;
+            case 'N':
+                item.kind = StaticItem::Kind::THREAD_NAME;
+                break;
+            case 'c':
+                item.kind = StaticItem::Kind::LOGGER;
+                break;
+            case 'p':
+                item.kind = StaticItem::Kind::LEVEL;
+                break;
+            case 'f':
+                item.kind = StaticItem::Kind::FILE;
+                break;
+            case 'l':
+                item.kind = StaticItem::Kind::LINE;
+                break;
+            case 'T':
+                item.kind = StaticItem::Kind::TAB;
+                break;
+            case 'm':
+                item.kind = StaticItem::Kind::MSG;
+                break;
+            case 'n':
+                item.kind = StaticItem::Kind::NLINE;
+                break;
+            case 'k':
+                item.kind = StaticItem::Kind::FIELDS;
+                break;
+            default:
+                throw "没有对应的格式化字符";
+        }
+        pos++;
+        if (pattern[pos] == '{') {
+            pos++;
+            item.pos = pos;
+            while (pattern[pos] != '\0' && pattern[pos] != '}') pos++;
+            if (pattern[pos] == '\0') throw "{}没有配对，格式错误";
+            item.len = pos - item.pos;
+            pos++;
+        } else if (item.kind == StaticItem::Kind::TIME) {
+            // 与TimeFormatItem一致，%d无{}时为空格式
+            item.pos = pos;
+            item.len = 0;
+        }
+        if (item.kind == StaticItem::Kind::FIELDS)
+            staticFieldStyle(pattern + item.pos, item.len);
+        if (item.kind == StaticItem::Kind::THREAD)
+            staticKernelTid(pattern + item.pos, item.len);
+        if (items) items[count] = item;
+        count++;
+        text_begin = pos;
+    }
+    flushText(pos);
+    return count;
+}
+
+template <const char *Pattern>
+class StaticFormatter {
+public:
+    static void format(std::string &out, const LogMsg &msg) {
+        formatItems(out, msg, std::make_index_sequence<kCount>());
+    }
+
+private:
+    static constexpr size_t kCount = parseStaticPattern(Pattern, nullptr);
+
+    static constexpr StaticItems<kCount> parse() {
+        StaticItems<kCount> res{};
+        res.size = parseStaticPattern(Pattern, res.items);
+        return res;
+    }
+    static constexpr StaticItems<kCount> kItems = parse();
+
+    // 与Formatter一致：格式中没有%k时由%m输出字段
+    static constexpr bool hasFields() {
+        for (size_t i = 0; i < kItems.size; i++)
+            if (kItems.items[i].kind == StaticItem::Kind::FIELDS) return true;
+        return false;
+    }
+
+    // 时间子格式需要以'\0'结尾才能交给strftime
+    template <size_t Pos, size_t Len>
+    struct TimeFormat {
+        static constexpr auto make() {
+            struct Str {
+                char data[Len + 1];
+            } str{};
+            for (size_t i = 0; i < Len; i++) str.data[i] = Pattern[Pos + i];
+            return str;
+        }
+        static constexpr auto value = make();
+    };
+
+    template <size_t... I>
+    static void formatItems(std::string &out, const LogMsg &msg,
+                            std::index_sequence<I...>) {
+        (formatItem<I>(out, msg), ...);
+    }
+
+    template <size_t I>
+    static void formatItem(std::string &out, const LogMsg &msg) {
+        constexpr StaticItem item = kItems.items[I];
+        using Kind = StaticItem::Kind;
+        if constexpr (item.kind == Kind::TEXT) {
+            out.append(Pattern + item.pos, item.len);
+        } else if constexpr (item.kind == Kind::TIME) {
+            static const TimeRenderer renderer(
+                TimeFormat<item.pos, item.len>::value.data);
+            renderer.format(out, msg._c_time, msg._nsec);
+        } else if constexpr (item.kind == Kind::THREAD) {
+            if constexpr (staticKernelTid(Pattern + item.pos, item.len))
+                ThreadInfo::appendTid(out, msg._ktid);
+            else
+                appendThreadId(out, msg._tid);
+        } else if constexpr (item.kind == Kind::THREAD_NAME) {
+            ThreadInfo::appendName(out, msg._ktid);
+        } else if constexpr (item.kind == Kind::LOGGER) {
+            out.append(msg._logger);
+        } else if constexpr (item.kind == Kind::LEVEL) {
+            out.append(LogLevel::toCString(msg._level));
+        } else if constexpr (item.kind == Kind::FILE) {
+            out.append(msg._file);
+        } else if constexpr (item.kind == Kind::LINE) {
+            appendInteger(out, msg._line);
+        } else if constexpr (item.kind == Kind::TAB) {
+            out.push_back('\t');
+        } else if constexpr (item.kind == Kind::NLINE) {
+            out.push_back('\n');
+        } else if constexpr (item.kind == Kind::MSG) {
+            out.append(msg._payload);
+            if constexpr (!hasFields()) {
+                if (!msg._fields.empty()) {
+                    if (!msg._payload.empty()) out.push_back(' ');
+                    FieldCodec::render(out, msg._fields,
+                                       FieldCodec::Style::LOGFMT);
+                }
+            }
+        } else if constexpr (item.kind == Kind::FIELDS) {
+            constexpr FieldCodec::Style style =
+                staticFieldStyle(Pattern + item.pos, item.len);
+            FieldCodec::render(out, msg._fields, style);
+        }
+    }
+};
+}  // namespace wlog
@@ -0,0 +1,137 @@
+// 线程信息
+//   1. 每个线程缓存自己的内核线程ID(gettid)及其十进制字符串，
+//      与top、perf中看到的线程ID一致，渲染时只需memcpy
+//   2. 线程名称通过wlog::setThreadName设置，同时写入内核(top -H、perf可见)
+//   3. 名称登记在全局表中，格式化线程按内核线程ID查找，查找结果按线程缓存，
+//      表发生变化时缓存失效
+//   4. 线程退出后名称仍然保留，延迟格式化的记录在线程退出后落地也能输出名称；
+//      内核线程ID被新线程复用时，由新线程在第一次使用时清除旧名称
+#pragma once
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace wlog {
+class ThreadInfo {
+public:
+    // 名称的最大长度，超出部分被截断
+    static constexpr size_t kMaxNameLen = 31;
+
+    // 当前线程的内核线程ID
+    static pid_t tid() { return local()._tid; }
+
+    // 设置当前线程的名称；内核中的名称最多15个字节
+    static void setName(std::string_view name) {
+        Local &self = local();
+        name = name.substr(0, kMaxNameLen);
+        char kernel_name[16];
+        size_t len = std::min(name.size(), sizeof(kernel_name) - 1);
+        memcpy(kernel_name, name.data(), len);
+        kernel_name[len] = '\0';
+        pthread_setname_np(pthread_self(), kernel_name);
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.names[self._tid] = std::string(name);
+        reg.version.fetch_add(1, std::memory_order_release);
+    }
+
+    // 追加内核线程ID的十进制字符串
+    static void appendTid(std::string &out, pid_t tid) {
+        Local &self = local();
+        if (tid == self._tid) {
+            out.append(self._tid_str, self._tid_len);
+            return;
+        }
+        // 格式化线程渲染其他线程的ID
+        char tmp[16];
+        auto res = std::to_chars(tmp, tmp + sizeof(tmp), tid);
+        out.append(tmp, res.ptr - tmp);
+    }
+
+    // 追加线程名称，没有设置名称时输出内核线程ID
+    static void appendName(std::string &out, pid_t tid) {
+        Registry &reg = registry();
+        uint64_t version = reg.version.load(std::memory_order_acquire);
+        if (version == 0) {
+            appendTid(out, tid);
+            return;
+        }
+        NameCache &cache = nameCache(tid);
+        if (cache.tid != tid || cache.version != version) {
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            auto it = reg.names.find(tid);
+            cache.len = 0;
+            if (it != reg.names.end()) {
+                cache.len = it->second.size();
+                memcpy(cache.name, it->second.data(), cache.len);
+            }
+            cache.tid = tid;
+            cache.version = version;
+        }
+        if (cache.len == 0) {
+            appendTid(out, tid);
+            return;
+        }
+        out.append(cache.name, cache.len);
+    }
+
+private:
+    // 每个线程自己的信息
+    struct Local {
+        pid_t _tid;
+        char _tid_str[16];
+        size_t _tid_len;
+
+        Local() : _tid((pid_t)syscall(SYS_gettid)) {
+            auto res = std::to_chars(_tid_str, _tid_str + sizeof(_tid_str),
+                                     _tid);
+            _tid_len = res.ptr - _tid_str;
+            // 清除之前使用同一ID的线程留下的名称
+            Registry &reg = registry();
+            if (reg.version.load(std::memory_order_acquire) == 0) return;
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            if (reg.names.erase(_tid) != 0)
+                reg.version.fetch_add(1, std::memory_order_release);
+        }
+    };
+    struct Registry {
+        std::mutex mutex;
+        std::unordered_map<pid_t, std::string> names;
+        std::atomic<uint64_t> version{0};  // 每次变化加一，0表示从未设置过名称
+    };
+    // 格式化线程的名称缓存，按线程ID直接映射
+    struct NameCache {
+        pid_t tid = 0;
+        uint64_t version = 0;
+        char name[kMaxNameLen];
+        size_t len = 0;
+    };
+    static constexpr size_t kCacheSlots = 16;
+
+    static Local &local() {
+        static thread_local Local self;
+        return self;
+    }
+    static Registry &registry() {
+        // 不析构，静态对象析构期间的日志仍可查找名称
+        static Registry *reg = new Registry();
+        return *reg;
+    }
+    static NameCache &nameCache(pid_t tid) {
+        static thread_local NameCache caches[kCacheSlots];
+        return caches[(size_t)tid % kCacheSlots];
+    }
+};
+
+// 设置当前线程的名称，用于%N和top/perf中的线程名
+inline void setThreadName(std::string_view name) { ThreadInfo::setName(name); }
+}  // namespace wlog
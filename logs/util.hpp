@@ -7,6 +7,7 @@
 #include <endian.h>
 #include <sys/stat.h>
 
+#include <cstdint>
 #include <ctime>
 #include <string>
 
@@ -14,6 +15,13 @@ namespace wlog {
 class date {
 public:
     static size_t now() { return (size_t)time(nullptr); }
+    // 高精度时间：秒 + 秒内纳秒
+    static void preciseNow(time_t &sec, uint32_t &nsec) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        sec = ts.tv_sec;
+        nsec = (uint32_t)ts.tv_nsec;
+    }
 };
 class file {
 public:
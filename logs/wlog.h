@@ -4,28 +4,274 @@
 
 #include "logger.hpp"
 
+// 编译期日志等级阈值：低于该等级的WLOG_xxx调用在预处理阶段被整体移除，
+// 参数不会被求值。需要在包含本头文件之前定义，例如 -DWLOG_ACTIVE_LEVEL=1
+#define WLOG_LEVEL_DEBUG 0
+#define WLOG_LEVEL_INFO 1
+#define WLOG_LEVEL_WARNING 2
+#define WLOG_LEVEL_ERROR 3
+#define WLOG_LEVEL_FATAL 4
+#define WLOG_LEVEL_OFF 5
+#ifndef WLOG_ACTIVE_LEVEL
+#define WLOG_ACTIVE_LEVEL WLOG_LEVEL_DEBUG
+#endif
+
 namespace wlog {
 // 1. 获取指定日志器的全局接口
-Logger::ptr getLogger(const std::string& name) {
+inline Logger::ptr getLogger(const std::string& name) {
     return wlog::LoggerManager::getInstance().getLogger(name);
 }
 
-Logger::ptr rootLogger() {
+inline const Logger::ptr& rootLogger() {
     return wlog::LoggerManager::getInstance().rootLogger();
 }
 
+// 按调用点缓存的日志器查找，name需要是字面量；找到之后每次调用只有一次
+// acquire读取，不查表、不增加引用计数。日志器尚未注册时返回nullptr，
+// 之后的调用会重新查找。WLOG_xxx宏把空日志器当作关闭，跳过这次调用，例如：
+//   WLOG_INFO(WLOG_LOGGER("async_logger"), "%d", n);  // 注册之前不输出
+// 直接使用返回值时需要先判空：
+//   if (wlog::Logger* lg = WLOG_LOGGER("async_logger")) lg->info("%d", n);
+#define WLOG_LOGGER(name)                                    \
+    ([]() -> wlog::Logger* {                                 \
+        static wlog::CachedLogger _wlog_cached_logger(name); \
+        return _wlog_cached_logger.get();                    \
+    }())
+
 // 2. 使用宏函数进行代理
+//    注意：logger->debug(...)形式总是会先求值参数，再在函数内检查等级
 #define debug(fmt, ...) debug(__FILE__, __LINE__, fmt, ##__VA_ARGS__);
 #define info(fmt, ...) info(__FILE__, __LINE__, fmt, ##__VA_ARGS__);
 #define warning(fmt, ...) warning(__FILE__, __LINE__, fmt, ##__VA_ARGS__);
 #define error(fmt, ...) error(__FILE__, __LINE__, fmt, ##__VA_ARGS__);
 #define fatal(fmt, ...) fatal(__FILE__, __LINE__, fmt, ##__VA_ARGS__);
 
-// 3. 使用宏函数, 直接通过默认日志器进行标准输出的打印
-#define DEBUG(fmt, ...) wlog::rootLogger()->debug(fmt, ##__VA_ARGS__);
-#define INFO(fmt, ...) wlog::rootLogger()->info(fmt, ##__VA_ARGS__);
-#define WARNING(fmt, ...) wlog::rootLogger()->warning(fmt, ##__VA_ARGS__);
-#define ERROR(fmt, ...) wlog::rootLogger()->error(fmt, ##__VA_ARGS__);
-#define FATAL(fmt, ...) wlog::rootLogger()->fatal(fmt, ##__VA_ARGS__);
+// 3. 惰性求值的宏：先检查调用点开关和等级，通过后才求值参数
+//    每个调用点有一个常量初始化的静态描述符，可以在运行时单独打开或关闭，
+//    见callsite.hpp；关闭的调用点只做一次relaxed读取
+#define WLOG_CALLSITE(level)                                         \
+    static wlog::Callsite _wlog_callsite(__FILE__, __func__, __LINE__, \
+                                         wlog::LogLevel::Value::level)
+
+#define WLOG_LOG_IMPL(logger, level, fmt, ...)                             \
+    do {                                                                    \
+        WLOG_CALLSITE(level);                                              \
+        auto&& _wlog_logger = (logger);                                    \
+        if (_wlog_callsite.enabled(_wlog_logger))                          \
+            _wlog_logger->logAt(wlog::LogLevel::Value::level, __FILE__,    \
+                                __LINE__, fmt, ##__VA_ARGS__);             \
+    } while (0)
+
+// 结构化日志，字段用wlog::kv构造，例如：
+//   WLOG_INFO_KV(logger, "login", wlog::kv("uid", uid), wlog::kv("ok", true));
+#define WLOG_KV_IMPL(logger, level, msg, ...)                              \
+    do {                                                                    \
+        WLOG_CALLSITE(level);                                              \
+        auto&& _wlog_logger = (logger);                                    \
+        if (_wlog_callsite.enabled(_wlog_logger))                          \
+            _wlog_logger->logKv(wlog::LogLevel::Value::level, __FILE__,    \
+                                __LINE__, msg, {__VA_ARGS__});             \
+    } while (0)
+
+// 花括号格式，格式串必须是字面量，占位符与参数在编译期检查，例如：
+//   WLOG_INFO_FMT(logger, "user={} latency={}us ratio={:.2}", id, us, r);
+#define WLOG_FMT_IMPL(logger, level, fmt, ...)                             \
+    do {                                                                    \
+        static_assert(wlog::BraceFormat::check(                            \
+                          fmt, decltype(wlog::argTypes(__VA_ARGS__)){}),   \
+                      "格式串与参数不匹配: " fmt);                         \
+        WLOG_CALLSITE(level);                                              \
+        auto&& _wlog_logger = (logger);                                    \
+        if (_wlog_callsite.enabled(_wlog_logger))                          \
+            _wlog_logger->logFmt(wlog::LogLevel::Value::level, __FILE__,   \
+                                 __LINE__, fmt, ##__VA_ARGS__);            \
+    } while (0)
+
+#if WLOG_ACTIVE_LEVEL <= WLOG_LEVEL_DEBUG
+#define WLOG_DEBUG(logger, fmt, ...) \
+    WLOG_LOG_IMPL(logger, DEBUG, fmt, ##__VA_ARGS__)
+#define WLOG_DEBUG_KV(logger, msg, ...) \
+    WLOG_KV_IMPL(logger, DEBUG, msg, ##__VA_ARGS__)
+#define WLOG_DEBUG_FMT(logger, fmt, ...) \
+    WLOG_FMT_IMPL(logger, DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define WLOG_DEBUG(logger, fmt, ...) \
+    do {                              \
+    } while (0)
+#define WLOG_DEBUG_KV(logger, msg, ...) \
+    do {                                 \
+    } while (0)
+#define WLOG_DEBUG_FMT(logger, fmt, ...) \
+    do {                                  \
+    } while (0)
+#endif
+#if WLOG_ACTIVE_LEVEL <= WLOG_LEVEL_INFO
+#define WLOG_INFO(logger, fmt, ...) \
+    WLOG_LOG_IMPL(logger, INFO, fmt, ##__VA_ARGS__)
+#define WLOG_INFO_KV(logger, msg, ...) \
+    WLOG_KV_IMPL(logger, INFO, msg, ##__VA_ARGS__)
+#define WLOG_INFO_FMT(logger, fmt, ...) \
+    WLOG_FMT_IMPL(logger, INFO, fmt, ##__VA_ARGS__)
+#else
+#define WLOG_INFO(logger, fmt, ...) \
+    do {                             \
+    } while (0)
+#define WLOG_INFO_KV(logger, msg, ...) \
+    do {                                \
+    } while (0)
+#define WLOG_INFO_FMT(logger, fmt, ...) \
+    do {                                 \
+    } while (0)
+#endif
+#if WLOG_ACTIVE_LEVEL <= WLOG_LEVEL_WARNING
+#define WLOG_WARNING(logger, fmt, ...) \
+    WLOG_LOG_IMPL(logger, WARNING, fmt, ##__VA_ARGS__)
+#define WLOG_WARNING_KV(logger, msg, ...) \
+    WLOG_KV_IMPL(logger, WARNING, msg, ##__VA_ARGS__)
+#define WLOG_WARNING_FMT(logger, fmt, ...) \
+    WLOG_FMT_IMPL(logger, WARNING, fmt, ##__VA_ARGS__)
+#else
+#define WLOG_WARNING(logger, fmt, ...) \
+    do {                                \
+    } while (0)
+#define WLOG_WARNING_KV(logger, msg, ...) \
+    do {                                   \
+    } while (0)
+#define WLOG_WARNING_FMT(logger, fmt, ...) \
+    do {                                    \
+    } while (0)
+#endif
+#if WLOG_ACTIVE_LEVEL <= WLOG_LEVEL_ERROR
+#define WLOG_ERROR(logger, fmt, ...) \
+    WLOG_LOG_IMPL(logger, ERROR, fmt, ##__VA_ARGS__)
+#define WLOG_ERROR_KV(logger, msg, ...) \
+    WLOG_KV_IMPL(logger, ERROR, msg, ##__VA_ARGS__)
+#define WLOG_ERROR_FMT(logger, fmt, ...) \
+    WLOG_FMT_IMPL(logger, ERROR, fmt, ##__VA_ARGS__)
+#else
+#define WLOG_ERROR(logger, fmt, ...) \
+    do {                              \
+    } while (0)
+#define WLOG_ERROR_KV(logger, msg, ...) \
+    do {                                 \
+    } while (0)
+#define WLOG_ERROR_FMT(logger, fmt, ...) \
+    do {                                  \
+    } while (0)
+#endif
+#if WLOG_ACTIVE_LEVEL <= WLOG_LEVEL_FATAL
+#define WLOG_FATAL(logger, fmt, ...) \
+    WLOG_LOG_IMPL(logger, FATAL, fmt, ##__VA_ARGS__)
+#define WLOG_FATAL_KV(logger, msg, ...) \
+    WLOG_KV_IMPL(logger, FATAL, msg, ##__VA_ARGS__)
+#define WLOG_FATAL_FMT(logger, fmt, ...) \
+    WLOG_FMT_IMPL(logger, FATAL, fmt, ##__VA_ARGS__)
+#else
+#define WLOG_FATAL(logger, fmt, ...) \
+    do {                              \
+    } while (0)
+#define WLOG_FATAL_KV(logger, msg, ...) \
+    do {                                 \
+    } while (0)
+#define WLOG_FATAL_FMT(logger, fmt, ...) \
+    do {                                  \
+    } while (0)
+#endif
+
+// 4. 使用宏函数, 直接通过默认日志器进行标准输出的打印
+#define DEBUG(fmt, ...) WLOG_DEBUG(wlog::rootLogger(), fmt, ##__VA_ARGS__)
+#define INFO(fmt, ...) WLOG_INFO(wlog::rootLogger(), fmt, ##__VA_ARGS__)
+#define WARNING(fmt, ...) WLOG_WARNING(wlog::rootLogger(), fmt, ##__VA_ARGS__)
+#define ERROR(fmt, ...) WLOG_ERROR(wlog::rootLogger(), fmt, ##__VA_ARGS__)
+#define FATAL(fmt, ...) WLOG_FATAL(wlog::rootLogger(), fmt, ##__VA_ARGS__)
+#define DEBUG_KV(msg, ...) WLOG_DEBUG_KV(wlog::rootLogger(), msg, ##__VA_ARGS__)
+#define INFO_KV(msg, ...) WLOG_INFO_KV(wlog::rootLogger(), msg, ##__VA_ARGS__)
+#define WARNING_KV(msg, ...) \
+    WLOG_WARNING_KV(wlog::rootLogger(), msg, ##__VA_ARGS__)
+#define ERROR_KV(msg, ...) WLOG_ERROR_KV(wlog::rootLogger(), msg, ##__VA_ARGS__)
+#define FATAL_KV(msg, ...) WLOG_FATAL_KV(wlog::rootLogger(), msg, ##__VA_ARGS__)
+#define DEBUG_FMT(fmt, ...) \
+    WLOG_DEBUG_FMT(wlog::rootLogger(), fmt, ##__VA_ARGS__)
+#define INFO_FMT(fmt, ...) WLOG_INFO_FMT(wlog::rootLogger(), fmt, ##__VA_ARGS__)
+#define WARNING_FMT(fmt, ...) \
+    WLOG_WARNING_FMT(wlog::rootLogger(), fmt, ##__VA_ARGS__)
+#define ERROR_FMT(fmt, ...) \
+    WLOG_ERROR_FMT(wlog::rootLogger(), fmt, ##__VA_ARGS__)
+#define FATAL_FMT(fmt, ...) \
+    WLOG_FATAL_FMT(wlog::rootLogger(), fmt, ##__VA_ARGS__)
+
+// 5. 调用点限流：level为DEBUG/INFO/WARNING/ERROR/FATAL，
+//    被抑制的调用只做一次原子操作，参数不会被求值，例如：
+//      WLOG_EVERY_N(logger, ERROR, 1000, "连接失败: %s", err);
+//      WLOG_PER_SECOND(logger, WARNING, 5, "队列已满");
+//      WLOG_FIRST_N(logger, INFO, 3, "使用默认配置");
+//    下一条输出的日志带有suppressed=<被抑制的条数>字段
+#define WLOG_LIMIT_IMPL(logger, level, limiter, n, fmt, ...)                \
+    do {                                                                     \
+        WLOG_CALLSITE(level);                                               \
+        static limiter _wlog_limiter;                                       \
+        auto&& _wlog_logger = (logger);                                     \
+        uint64_t _wlog_suppressed = 0;                                      \
+        if (_wlog_callsite.enabled(_wlog_logger) &&                         \
+            _wlog_limiter.allow((n), _wlog_suppressed))                     \
+            _wlog_logger->logSuppressed(wlog::LogLevel::Value::level,       \
+                                        __FILE__, __LINE__,                 \
+                                        _wlog_suppressed, fmt,              \
+                                        ##__VA_ARGS__);                     \
+    } while (0)
+
+// 按等级分派：低于WLOG_ACTIVE_LEVEL的等级与其他WLOG_xxx宏一样在预处理阶段移除
+#define WLOG_LIMIT_LEVEL(logger, level, limiter, n, fmt, ...) \
+    WLOG_LIMIT_##level(logger, limiter, n, fmt, ##__VA_ARGS__)
+#if WLOG_ACTIVE_LEVEL <= WLOG_LEVEL_DEBUG
+#define WLOG_LIMIT_DEBUG(logger, limiter, n, fmt, ...) \
+    WLOG_LIMIT_IMPL(logger, DEBUG, limiter, n, fmt, ##__VA_ARGS__)
+#else
+#define WLOG_LIMIT_DEBUG(logger, limiter, n, fmt, ...) \
+    do {                                               \
+    } while (0)
+#endif
+#if WLOG_ACTIVE_LEVEL <= WLOG_LEVEL_INFO
+#define WLOG_LIMIT_INFO(logger, limiter, n, fmt, ...) \
+    WLOG_LIMIT_IMPL(logger, INFO, limiter, n, fmt, ##__VA_ARGS__)
+#else
+#define WLOG_LIMIT_INFO(logger, limiter, n, fmt, ...) \
+    do {                                              \
+    } while (0)
+#endif
+#if WLOG_ACTIVE_LEVEL <= WLOG_LEVEL_WARNING
+#define WLOG_LIMIT_WARNING(logger, limiter, n, fmt, ...) \
+    WLOG_LIMIT_IMPL(logger, WARNING, limiter, n, fmt, ##__VA_ARGS__)
+#else
+#define WLOG_LIMIT_WARNING(logger, limiter, n, fmt, ...) \
+    do {                                                 \
+    } while (0)
+#endif
+#if WLOG_ACTIVE_LEVEL <= WLOG_LEVEL_ERROR
+#define WLOG_LIMIT_ERROR(logger, limiter, n, fmt, ...) \
+    WLOG_LIMIT_IMPL(logger, ERROR, limiter, n, fmt, ##__VA_ARGS__)
+#else
+#define WLOG_LIMIT_ERROR(logger, limiter, n, fmt, ...) \
+    do {                                               \
+    } while (0)
+#endif
+#if WLOG_ACTIVE_LEVEL <= WLOG_LEVEL_FATAL
+#define WLOG_LIMIT_FATAL(logger, limiter, n, fmt, ...) \
+    WLOG_LIMIT_IMPL(logger, FATAL, limiter, n, fmt, ##__VA_ARGS__)
+#else
+#define WLOG_LIMIT_FATAL(logger, limiter, n, fmt, ...) \
+    do {                                               \
+    } while (0)
+#endif
+
+// 每n次输出一次
+#define WLOG_EVERY_N(logger, level, n, fmt, ...) \
+    WLOG_LIMIT_LEVEL(logger, level, wlog::EveryNLimiter, n, fmt, ##__VA_ARGS__)
+// 只输出前n次
+#define WLOG_FIRST_N(logger, level, n, fmt, ...) \
+    WLOG_LIMIT_LEVEL(logger, level, wlog::FirstNLimiter, n, fmt, ##__VA_ARGS__)
+// 每秒最多输出k次
+#define WLOG_PER_SECOND(logger, level, k, fmt, ...) \
+    WLOG_LIMIT_LEVEL(logger, level, wlog::RateLimiter, k, fmt, ##__VA_ARGS__)
 
 }  // namespace wlog